@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "admission.h"
+#include "decisions.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "stats.h"
+
+//a program that has its PCB but no frames yet
+typedef struct PendingProgram {
+    PCB *pcb;
+    ReadyQueue *queue;          //queue it joins, the one that was running when it was submitted
+    int policy;                 //POLICY_* to enqueue its PCB with
+    uint64_t enqueued_at;       //stats_now() when it started waiting
+    struct PendingProgram *next;
+} PendingProgram;
+
+static PendingProgram *pending_head = NULL;     //programs in arrival order
+static PendingProgram *pending_tail = NULL;
+
+int admission_order = ADMISSION_FIFO;
+AdmissionCounters admission_counters;
+
+//load a program's first pages if frames can be promised to it, returns 1 if it was admitted
+static int place_program(PCB *pcb) {
+    if (!paging_has_room(pcb)) {
+        return 0;
+    }
+    load_initial_pages(pcb);
+    admission_counters.admitted++;
+    log_decision(DECISION_ADMIT, pcb, pcb->number_of_lines);
+    return 1;
+}
+
+int admission_has_room(int program_count) {
+    if (admission_counters.pending + program_count > ADMISSION_MAX_PENDING) {
+        admission_counters.rejected++;
+        return 0;
+    }
+    return 1;
+}
+
+int admission_submit(PCB *pcb, ReadyQueue *queue, int policy) {
+    //in FIFO order nothing may overtake a program that is already waiting
+    if ((!pending_head || admission_order == ADMISSION_SMALLEST) && place_program(pcb)) {
+        return 1;
+    }
+
+    log_decision(DECISION_WAIT, pcb, pcb->number_of_lines);
+    PendingProgram *program = malloc(sizeof(PendingProgram));
+    program->pcb = pcb;
+    program->queue = queue;
+    program->policy = policy;
+    program->enqueued_at = stats_now();
+    program->next = NULL;
+    if (pending_tail) {
+        pending_tail->next = program;
+    } else {
+        pending_head = program;
+    }
+    pending_tail = program;
+    admission_counters.pending++;
+    admission_counters.pending_lines += pcb->number_of_lines;
+    return 0;
+}
+
+void admission_run() {
+    while (pending_head) {
+        //pick the program to try: the head for FIFO, the smallest for ADMISSION_SMALLEST
+        PendingProgram *chosen = pending_head, *chosen_prev = NULL;
+        if (admission_order == ADMISSION_SMALLEST) {
+            for (PendingProgram * prev = pending_head; prev->next; prev = prev->next) {
+                if (prev->next->pcb->number_of_lines < chosen->pcb->number_of_lines) {
+                    chosen = prev->next;
+                    chosen_prev = prev;
+                }
+            }
+        }
+
+        if (!place_program(chosen->pcb)) {
+            return;             //if the chosen one doesn't fit, nothing after it gets to go either
+        }
+
+        //unlink it from the waiting list
+        if (chosen_prev) {
+            chosen_prev->next = chosen->next;
+        } else {
+            pending_head = chosen->next;
+        }
+        if (pending_tail == chosen) {
+            pending_tail = chosen_prev;
+        }
+
+        uint64_t wait = stats_now() - chosen->enqueued_at;
+        stats_record(&stats_commands[STAT_ADMISSION_WAIT], wait);
+        admission_counters.waited++;
+        admission_counters.total_wait_ns += wait;
+        if (wait > admission_counters.max_wait_ns) {
+            admission_counters.max_wait_ns = wait;
+        }
+        admission_counters.pending--;
+        admission_counters.pending_lines -= chosen->pcb->number_of_lines;
+
+        enqueue_arrival(chosen->queue, chosen->pcb, chosen->policy);    //run_foreground waits for it if its queue ran dry
+        free(chosen);
+    }
+}
+
+int admission_waiting(ReadyQueue *queue, PCB *pcbs[], int max) {
+    int count = 0;
+    for (PendingProgram * program = pending_head; program && count < max; program = program->next) {
+        if (program->queue == queue) {
+            pcbs[count++] = program->pcb;
+        }
+    }
+    return count;
+}
+
+int admission_pending(ReadyQueue *queue) {
+    int count = 0;
+    for (PendingProgram * program = pending_head; program; program = program->next) {
+        count += program->queue == queue;
+    }
+    return count;
+}
+
+//drop every waiting program of job job_id, or every one waiting to join queue if it isn't NULL
+static int cancel(int job_id, ReadyQueue *queue) {
+    int dropped = 0;
+    PendingProgram *prev = NULL, *program = pending_head;
+    while (program) {
+        PendingProgram *next = program->next;
+        if (queue ? program->queue != queue : program->pcb->job_id != job_id) {
+            prev = program;
+        } else {
+            //unlink it from the waiting list
+            if (prev) {
+                prev->next = next;
+            } else {
+                pending_head = next;
+            }
+            if (pending_tail == program) {
+                pending_tail = prev;
+            }
+            admission_counters.pending--;
+            admission_counters.pending_lines -= program->pcb->number_of_lines;
+            drop_process(program->pcb);
+            free(program);
+            dropped++;
+        }
+        program = next;
+    }
+    return dropped;
+}
+
+int admission_cancel(int job_id) {
+    return cancel(job_id, NULL);
+}
+
+int admission_cancel_queue(ReadyQueue *queue) {
+    return cancel(0, queue);
+}
+
+void admission_print() {
+    printf("order: %s\n", admission_order == ADMISSION_FIFO ? "FIFO" : "SMALLEST");
+    printf("pending: %d programs, %d lines\n", admission_counters.pending, admission_counters.pending_lines);
+    printf("admitted: %llu (%llu waited), rejected: %llu\n",
+           (unsigned long long) admission_counters.admitted,
+           (unsigned long long) admission_counters.waited,
+           (unsigned long long) admission_counters.rejected);
+    printf("wait: total %lluns, max %lluns\n",
+           (unsigned long long) admission_counters.total_wait_ns,
+           (unsigned long long) admission_counters.max_wait_ns);
+}
@@ -0,0 +1,43 @@
+#ifndef ADMISSION_H
+#   define ADMISSION_H
+
+#   include <stdint.h>
+#   include "pcb.h"
+#   include "readyqueue.h"
+
+//Admission control: program memory is demand paged, so any script fits, but each running
+//process is promised frames for its first pages (see paging_has_room). A program whose frames
+//can't be promised waits here until finishing processes give some back, instead of every
+//process thrashing over too few frames.
+
+#   define ADMISSION_MAX_PENDING 256    //programs that may wait at once, past this exec is refused so callers know to back off
+
+//order waiting programs are admitted in
+enum {
+    ADMISSION_FIFO,             //strictly in arrival order, a big program at the head holds back smaller ones behind it
+    ADMISSION_SMALLEST          //smallest waiting program goes first
+};
+
+typedef struct AdmissionCounters {
+    int pending;                //programs waiting right now
+    int pending_lines;          //lines those programs have
+    uint64_t admitted;          //programs that got into memory, right away or after waiting
+    uint64_t waited;            //how many of those had to wait
+    uint64_t rejected;          //submissions refused because the queue was full
+    uint64_t total_wait_ns;     //time spent waiting by admitted programs
+    uint64_t max_wait_ns;       //longest single wait
+} AdmissionCounters;
+
+extern int admission_order;     //ADMISSION_* currently in use
+extern AdmissionCounters admission_counters;
+
+int admission_has_room(int program_count);      //whether program_count more programs can wait, counts a rejection if not
+int admission_submit(PCB * pcb, ReadyQueue * queue, int policy);        //1 if pcb was admitted and the caller should enqueue it, 0 if it waits and admission_run will enqueue it in queue
+void admission_run();           //admit whatever fits now, called whenever frames are given back
+int admission_waiting(ReadyQueue * queue, PCB * pcbs[], int max);       //programs waiting to join queue, up to max of them, returns how many
+int admission_pending(ReadyQueue * queue);      //how many programs are waiting to join queue
+int admission_cancel(int job_id);       //drop every waiting program of a job, returns how many there were
+int admission_cancel_queue(ReadyQueue * queue); //drop every program waiting to join queue, returns how many there were
+void admission_print();         //print the counters
+
+#endif
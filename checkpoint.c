@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "admission.h"
+#include "jobs.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "shellmemory.h"
+
+#define SNAPSHOT_MAGIC "MYSHCKP1"       //also the format version, change it when the layout changes
+
+typedef struct SnapshotHeader {
+    char magic[8];
+    int32_t policy;             //POLICY_* the run was using
+    int32_t variable_count;
+    int32_t process_count;
+    int32_t reserved;           //keeps the 64 bit fields aligned
+    int64_t queue_pass;         //STRIDE virtual time
+    uint64_t lottery_state;
+} SnapshotHeader;
+
+//followed by the name and the value, without terminators
+typedef struct SnapshotVariable {
+    uint16_t name_length;
+    uint16_t value_length;
+} SnapshotVariable;
+
+//followed by text_length bytes of script, see backing_copy
+typedef struct SnapshotProcess {
+    int32_t pc;
+    int32_t number_of_lines;
+    int32_t job_length_score;   //with the aging it got while it waited applied
+    int32_t is_batch_script;
+    int32_t tickets;
+    int32_t text_length;
+    int64_t pass;
+} SnapshotProcess;
+
+int checkpoint_every = 0;
+static char *periodic_path = NULL;      //where periodic snapshots go, NULL when they are off
+static int since_last = 0;      //instructions since the last periodic snapshot
+
+static int write_variable(FILE *out, const char *name, const char *value) {
+    size_t name_length = strlen(name), value_length = strlen(value);
+    if (name_length > UINT16_MAX || value_length > UINT16_MAX) {
+        return -1;
+    }
+    SnapshotVariable record = {.name_length = name_length,.value_length = value_length };
+    if (fwrite(&record, sizeof(record), 1, out) != 1
+        || fwrite(name, 1, name_length, out) != name_length || fwrite(value, 1, value_length, out) != value_length) {
+        return -1;
+    }
+    return 0;
+}
+
+//the text goes first and its length is filled in afterwards, so the script is only read once
+static int write_process(FILE *out, PCB *pcb, int score) {
+    SnapshotProcess record = {
+        .pc = pcb->pc,
+        .number_of_lines = pcb->number_of_lines,
+        .job_length_score = score,
+        .is_batch_script = pcb->is_batch_script,
+        .tickets = pcb->tickets,
+        .pass = pcb->pass,
+    };
+    long at = ftell(out);
+    if (fwrite(&record, sizeof(record), 1, out) != 1) {
+        return -1;
+    }
+    long length = backing_copy(pcb->backing, out);
+    if (length < 0 || length > INT32_MAX) {
+        return -1;
+    }
+    record.text_length = length;
+    if (fseek(out, at, SEEK_SET) != 0 || fwrite(&record, sizeof(record), 1, out) != 1) {
+        return -1;
+    }
+    return fseek(out, 0, SEEK_END);
+}
+
+//pcb's parent is waiting for it, and for the rest of its children
+static int parent_blocked(PCB *pcb) {
+    return pcb->parent && pcb->parent->blocked;
+}
+
+//a blocked process is in no queue, but its children are: in it, running, or waiting for admission
+int checkpoint_blocked(PCB *running) {
+    ReadyQueue *queue = foreground_queue;
+    if (running && parent_blocked(running)) {
+        return 1;
+    }
+    if (!queue) {
+        return 0;
+    }
+    for (PCB * pcb = queue->head; pcb; pcb = pcb->next) {
+        if (parent_blocked(pcb)) {
+            return 1;
+        }
+    }
+    for (int i = 0; i < queue->heap_size; i++) {
+        if (parent_blocked(queue->heap[i])) {
+            return 1;
+        }
+    }
+    for (int slot = 0; slot < queue->slot_count; slot++) {
+        if (queue->slots[slot] && parent_blocked(queue->slots[slot])) {
+            return 1;
+        }
+    }
+    PCB *waiting[ADMISSION_MAX_PENDING];
+    int count = admission_waiting(queue, waiting, ADMISSION_MAX_PENDING);
+    for (int i = 0; i < count; i++) {
+        if (parent_blocked(waiting[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static ReadyQueue *sorting;     //queue whose heap compare_heap puts in order
+
+static int compare_heap(const void *a, const void *b) {
+    PCB *pcb_a = *(PCB **) a, *pcb_b = *(PCB **) b;
+    return heap_runs_before(sorting, pcb_a, pcb_b) ? -1 : heap_runs_before(sorting, pcb_b, pcb_a);
+}
+
+int checkpoint_write(const char *path, PCB *running) {
+    char temporary[strlen(path) + sizeof(".tmp")];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *out = fopen(temporary, "wb");
+    if (!out) {
+        return -1;
+    }
+
+    ReadyQueue *queue = foreground_queue;
+    SnapshotHeader header = {
+        .magic = SNAPSHOT_MAGIC,
+        .policy = queue ? foreground_policy : POLICY_FCFS,
+        .queue_pass = queue ? queue->pass : 0,
+        .lottery_state = lottery_state,
+    };
+    int failed = fwrite(&header, sizeof(header), 1, out) != 1;
+    for (int slot = 0; slot < mem_slot_count() && !failed; slot++) {
+        const char *value = mem_get_slot(slot);
+        if (value) {            //interned by a script line but never set
+            failed = write_variable(out, mem_slot_name(slot), value);
+            header.variable_count++;
+        }
+    }
+
+    //the process running an instruction goes first, it resumes at that instruction
+    if (running && running->backing && !failed) {
+        failed = write_process(out, running, running->job_length_score);
+        header.process_count++;
+    }
+    if (queue) {
+        for (PCB * pcb = queue->head; pcb && !failed; pcb = pcb->next) {
+            if (pcb->backing) {
+                failed = write_process(out, pcb, queued_score(queue, pcb));
+                header.process_count++;
+            }
+        }
+        //STRIDE, EDF, SJF or AGING is running, their heap goes out in the order they run it
+        PCB *heap[queue->heap_size + 1];
+        memcpy(heap, queue->heap, queue->heap_size * sizeof(PCB *));
+        sorting = queue;
+        qsort(heap, queue->heap_size, sizeof(PCB *), compare_heap);
+        for (int i = 0; i < queue->heap_size && !failed; i++) {
+            failed = write_process(out, heap[i], queue->by_score ? queued_score(queue, heap[i]) : heap[i]->job_length_score);
+            header.process_count++;
+        }
+        for (int slot = 0; slot < queue->slot_count && !failed; slot++) {      //LOTTERY is running
+            if (queue->slots[slot]) {
+                failed = write_process(out, queue->slots[slot], queue->slots[slot]->job_length_score);
+                header.process_count++;
+            }
+        }
+    }
+
+    //the counts are only known now, then make sure it is on disk before it replaces the old one
+    if (!failed) {
+        failed = fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1
+            || fflush(out) != 0 || fsync(fileno(out)) != 0;
+    }
+    if (fclose(out) != 0 || failed || rename(temporary, path) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+void checkpoint_schedule(const char *path, int every) {
+    free(periodic_path);
+    periodic_path = every > 0 ? strdup(path) : NULL;
+    checkpoint_every = every > 0 ? every : 0;
+    since_last = 0;
+}
+
+void checkpoint_tick(PCB *pcb) {
+    if (!checkpoint_every || ++since_last < checkpoint_every) {
+        return;
+    }
+    if (checkpoint_blocked(pcb)) {
+        since_last = checkpoint_every - 1;      //try again at the next instruction
+        return;
+    }
+    since_last = 0;
+    if (checkpoint_write(periodic_path, pcb) != 0) {
+        printf("error: can't write checkpoint %s, periodic checkpoints stopped\n", periodic_path);
+        checkpoint_schedule(NULL, 0);
+    }
+}
+
+//reads from the mapped snapshot, never past its end
+typedef struct Cursor {
+    const char *at;
+    const char *end;
+} Cursor;
+
+//the next length bytes, NULL if the snapshot is cut short
+static const char *take(Cursor *cursor, size_t length) {
+    if ((size_t) (cursor->end - cursor->at) < length) {
+        return NULL;
+    }
+    const char *start = cursor->at;
+    cursor->at += length;
+    return start;
+}
+
+//records in the file aren't aligned, so they are copied out rather than pointed at
+static int take_record(Cursor *cursor, void *record, size_t size) {
+    const char *start = take(cursor, size);
+    if (!start) {
+        return 0;
+    }
+    memcpy(record, start, size);
+    return 1;
+}
+
+//walk the variables without setting them, 1 if they are all there
+static int skip_variables(Cursor *cursor, int count) {
+    for (int i = 0; i < count; i++) {
+        SnapshotVariable record;
+        if (!take_record(cursor, &record, sizeof(record)) || record.name_length == 0
+            || !take(cursor, record.name_length + record.value_length)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//index every process's script, before anything is changed so a damaged snapshot restores nothing
+static int read_processes(Cursor *cursor, int count, SnapshotProcess records[], BackingStore *programs[]) {
+    for (int i = 0; i < count; i++) {
+        SnapshotProcess *record = &records[i];
+        const char *text = NULL;
+        programs[i] = NULL;
+        if (take_record(cursor, record, sizeof(*record)) && record->text_length > 0
+            && record->tickets >= 1 && record->tickets <= STRIDE1 && record->pc >= 0) {
+            text = take(cursor, record->text_length);
+        }
+        FILE *stream = text ? fmemopen((void *) text, record->text_length, "r") : NULL;
+        if (stream) {
+            programs[i] = backing_from_stream(stream);  //the mapping goes away, the script needs a file of its own
+            fclose(stream);
+        }
+        if (!programs[i] || programs[i]->line_count != record->number_of_lines
+            || record->pc >= record->number_of_lines) {
+            for (int j = 0; j <= i; j++) {
+                backing_close(programs[j]);
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void restore_variables(Cursor *cursor, int count) {
+    for (int i = 0; i < count; i++) {
+        SnapshotVariable record;
+        take_record(cursor, &record, sizeof(record));
+        char *name = strndup(take(cursor, record.name_length), record.name_length);
+        char *value = strndup(take(cursor, record.value_length), record.value_length);
+        mem_set_value(name, value);
+        free(name);
+        free(value);
+    }
+}
+
+//the processes join global_queue in the order they were saved, which is the policy's order
+static void restore_processes(const SnapshotHeader *header, SnapshotProcess records[], BackingStore *programs[]) {
+    if (!global_queue) {
+        global_queue = create_queue();
+    }
+    global_queue->pass = header->queue_pass;
+    for (int i = 0; i < header->process_count; i++) {
+        PCB *pcb = create_pcb(allocate_pid(), programs[i], records[i].number_of_lines);
+        pcb->pc = records[i].pc;
+        pcb->job_length_score = records[i].job_length_score;
+        pcb->is_batch_script = records[i].is_batch_script;
+        pcb_set_tickets(pcb, records[i].tickets);
+        pcb->pass = records[i].pass;
+        if (admission_submit(pcb, global_queue, header->policy)) {
+            if (header->policy == POLICY_STRIDE) {
+                enqueue_arrival(global_queue, pcb, header->policy);
+            } else {
+                enqueue(global_queue, pcb);
+            }
+        }
+        //otherwise admission_run enqueues it once enough frames are free
+    }
+    global_queue->sorted = header->policy == POLICY_SJF || header->policy == POLICY_AGING;
+    admission_run();
+}
+
+int checkpoint_restore(const char *path, int *policy) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return CHECKPOINT_NO_FILE;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(SnapshotHeader)) {
+        close(fd);
+        return CHECKPOINT_CORRUPT;
+    }
+    char *snapshot = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                  //the mapping keeps the file
+    if (snapshot == MAP_FAILED) {
+        return CHECKPOINT_NO_FILE;
+    }
+
+    Cursor cursor = {.at = snapshot,.end = snapshot + info.st_size };
+    SnapshotHeader header;
+    take_record(&cursor, &header, sizeof(header));
+    int status = 0;
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.policy < 0 || header.policy >= POLICY_COUNT
+        || header.variable_count < 0 || header.process_count < 0 || header.process_count > ADMISSION_MAX_PENDING) {
+        status = CHECKPOINT_CORRUPT;
+    } else if (!admission_has_room(header.process_count)) {
+        status = CHECKPOINT_BUSY;
+    }
+
+    Cursor variables = cursor;
+    SnapshotProcess records[status ? 1 : header.process_count + 1];
+    BackingStore *programs[status ? 1 : header.process_count + 1];
+    if (!status && !(skip_variables(&cursor, header.variable_count)
+                     && read_processes(&cursor, header.process_count, records, programs))) {
+        status = CHECKPOINT_CORRUPT;
+    }
+    if (!status) {
+        restore_variables(&variables, header.variable_count);
+        restore_processes(&header, records, programs);
+        if (header.lottery_state) {
+            lottery_state = header.lottery_state;
+        }
+        *policy = header.policy;
+    }
+    munmap(snapshot, info.st_size);
+    return status;
+}
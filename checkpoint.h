@@ -0,0 +1,36 @@
+#ifndef CHECKPOINT_H
+#   define CHECKPOINT_H
+
+#   include "pcb.h"
+
+//Checkpoints: a binary snapshot of the shell variables and of the foreground run (exec, source),
+//so a shell that died part way through a long run can carry on where it stopped.
+//  checkpoint PATH         write a snapshot now; typed while a run is going, it holds the run
+//  checkpoint PATH EVERY   and write it again every EVERY instructions of foreground runs, 0 stops
+//  restore PATH            set the variables and resume the run the snapshot holds
+//A snapshot is a header, the variables, then every process of the run in queue order with its
+//pc, job length score, tickets and pass followed by the text of its script. It is written to
+//PATH.tmp and renamed over PATH, so a crash while writing leaves the last snapshot whole.
+//restore maps the file and reads it in place, so it takes time in proportion to the snapshot,
+//not to the instructions that already ran. A process that was part way through a time slice
+//or quantum starts a fresh one, like after a yield.
+//Not saved: EDF deadlines (restored processes have none), background jobs, programs still waiting for admission, dag scripts that weren't released
+//yet. A process waiting for its children in a nested exec or source is in no queue, so while
+//one is, checkpoint refuses and periodic snapshots wait until its exec or source returns.
+
+//checkpoint_restore results other than 0
+enum {
+    CHECKPOINT_NO_FILE = 1,     //the snapshot can't be opened
+    CHECKPOINT_CORRUPT,         //it isn't a snapshot, or it is cut short
+    CHECKPOINT_BUSY,            //the admission queue is full
+};
+
+extern int checkpoint_every;    //instructions between periodic snapshots, 0 for none
+
+int checkpoint_blocked(PCB * running);  //whether a process of the foreground run waits in a nested exec or source, running as for checkpoint_write
+int checkpoint_write(const char *path, PCB * running);  //snapshot the variables and the foreground run, running is the process out of the queue running an instruction (NULL if none), returns 0 or -1
+void checkpoint_schedule(const char *path, int every);  //write path again every every instructions
+void checkpoint_tick(PCB * pcb);        //count an instruction of a foreground run, writes the periodic snapshot when it is due
+int checkpoint_restore(const char *path, int *policy);  //set the variables and put the snapshot's processes in global_queue, returns 0 or a CHECKPOINT_* error
+
+#endif
@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>             // PATH_MAX
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>            // va_list for reply
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>           // struct timeval for SO_RCVTIMEO
+#include <sys/un.h>
+#include "admission.h"
+#include "daemon.h"
+#include "interpreter.h"
+#include "scheduler.h"
+#include "paging.h"
+#include "shellmemory.h"
+#include "stats.h"
+
+#define DAEMON_MAX_REQUEST 4096 //longest request line we accept
+#define DAEMON_MAX_PROGRAMS 16  //scripts per SUBMIT
+#define DAEMON_MAX_WATCHERS 64  //clients streaming output with WAIT at once
+#define DAEMON_MAX_CLIENTS 256  //connections open at once, the rest wait in the listen backlog
+#define DAEMON_KEEP_OUTPUTS 128 //finished jobs whose output can still be fetched
+#define DAEMON_POLL_INTERVAL_NS 1000000 //while jobs run, look at the socket at most once a millisecond
+
+enum { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED };
+static const char *job_state_names[] = { "QUEUED", "RUNNING", "DONE", "FAILED" };
+
+//one SUBMIT request, made of one PCB per script
+typedef struct DaemonJob {
+    int id;                     //job id handed back to the client, index + 1 in jobs
+    int policy;                 //POLICY_* the job asked for
+    int tickets;                //its share under STRIDE and LOTTERY, or its deadline under EDF
+    int state;                  //JOB_*
+    int program_count;          //number of scripts
+    char *paths[DAEMON_MAX_PROGRAMS];   //scripts to load, freed once the job starts
+    int processes_left;         //PCBs of this job that haven't finished
+    int lines_total;            //instructions across all scripts
+    int lines_done;             //instructions run so far
+    int output_fd;              //unlinked temp file holding everything the job printed, -1 once expired
+} DaemonJob;
+
+//a connected client. Its socket is non-blocking once the request is read: answers and job
+//output go out as fast as it reads them, a client that stops reading only holds up itself
+typedef struct Client {
+    int fd;                     //client socket
+    char *out;                  //reply text not sent yet
+    size_t out_length;
+    size_t out_sent;
+    int job_id;                 //job whose output goes out after the reply (OUTPUT and WAIT), 0 for none
+    off_t offset;               //how much of that output was already sent
+    int follow;                 //WAIT: keep sending output until the job is over
+    off_t end;                  //OUTPUT: where the output ended when it was asked for
+    int stuck;                  //its socket was full, wait for POLLOUT
+} Client;
+
+static DaemonJob *jobs = NULL;  //every job ever submitted, grows as needed
+static int job_count = 0;
+static int job_capacity = 0;
+static Client clients[DAEMON_MAX_CLIENTS];
+static int client_count = 0;
+
+static int listen_fd = -1;
+static int running_policy = -1; //policy global_queue is being run with, -1 when idle
+static int output_job = 0;      //job stdout currently points at, 0 for the daemon's own stdout
+static int saved_stdout = -1;   //the daemon's own stdout
+static uint64_t last_service = 0;       //when we last looked at the socket
+static char socket_file[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+static DaemonJob *find_job(int id) {
+    if (id < 1 || id > job_count) {
+        return NULL;
+    }
+    return &jobs[id - 1];
+}
+
+//point stdout (and so every command and run child) at a job's output file
+static void switch_output(int job_id) {
+    fflush(stdout);
+    if (job_id == 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+    } else {
+        dup2(find_job(job_id)->output_fd, STDOUT_FILENO);
+    }
+    output_job = job_id;
+}
+
+//send a whole buffer, giving up if the other end went away (the client sending its request)
+static void send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+static void reply(Client * client, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+//queue a line for the client, service_clients sends it when the socket takes it
+static void reply(Client *client, const char *fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < 0) {
+        return;                 //nothing sensible to send
+    }
+    size_t length = (size_t) len >= sizeof(buf) ? sizeof(buf) - 1 : (size_t) len;       //cut to what fit in buf
+    client->out = realloc(client->out, client->out_length + length);
+    memcpy(client->out + client->out_length, buf, length);
+    client->out_length += length;
+}
+
+//send what the socket takes without blocking: the reply, then the job output from offset on.
+//Returns 1 when the client is done with (everything sent, or it went away)
+static int flush_client(Client *client) {
+    client->stuck = 0;
+    while (client->out_sent < client->out_length) {
+        ssize_t n = send(client->fd, client->out + client->out_sent, client->out_length - client->out_sent, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            client->stuck = 1;
+            return 0;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+        client->out_sent += n;
+    }
+    DaemonJob *job = find_job(client->job_id);
+    if (!job || job->output_fd < 0) {
+        return 1;
+    }
+    char buf[8192];
+    while (client->follow || client->offset < client->end) {
+        size_t want = sizeof(buf);
+        if (!client->follow && (off_t) want > client->end - client->offset) {
+            want = client->end - client->offset;
+        }
+        ssize_t got = pread(job->output_fd, buf, want, client->offset);
+        if (got <= 0) {
+            break;              //it has everything the job printed so far
+        }
+        ssize_t n = send(client->fd, buf, got, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            client->stuck = 1;
+            return 0;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+        client->offset += n;    //whatever it didn't take is read again next time
+    }
+    return !client->follow || job->state >= JOB_DONE;
+}
+
+//only the newest DAEMON_KEEP_OUTPUTS finished jobs keep their output file open
+static void expire_old_outputs() {
+    int kept = 0;
+    for (int i = job_count - 1; i >= 0; i--) {
+        DaemonJob *job = &jobs[i];
+        if (job->output_fd < 0 || job->state < JOB_DONE) {
+            continue;
+        }
+        if (++kept <= DAEMON_KEEP_OUTPUTS) {
+            continue;
+        }
+        int watched = 0;
+        for (int c = 0; c < client_count; c++) {
+            if (clients[c].job_id == job->id) {
+                watched = 1;
+            }
+        }
+        if (!watched) {
+            close(job->output_fd);
+            job->output_fd = -1;
+        }
+    }
+}
+
+static void free_paths(DaemonJob *job) {
+    for (int i = 0; i < job->program_count; i++) {
+        free(job->paths[i]);
+        job->paths[i] = NULL;
+    }
+}
+
+//scripts that can't be promised frames yet wait in the admission queue
+//returns 1 if a script doesn't exist, 2 if the admission queue is full, 0 on success
+static int start_job(DaemonJob *job) {
+    BackingStore *programs[DAEMON_MAX_PROGRAMS];
+    int line_count_total = 0;
+    int status = 0;
+
+    for (int i = 0; i < job->program_count && status == 0; i++) {
+        programs[i] = backing_open(job->paths[i]);
+        if (!programs[i]) {
+            for (int j = 0; j < i; j++) {       //drop whatever was already opened
+                backing_close(programs[j]);
+            }
+            status = 1;
+        } else {
+            line_count_total += programs[i]->line_count;
+        }
+    }
+    if (status == 0 && !admission_has_room(job->program_count)) {
+        for (int i = 0; i < job->program_count; i++) {
+            backing_close(programs[i]);
+        }
+        status = 2;
+    }
+    free_paths(job);
+    if (status != 0) {
+        job->state = JOB_FAILED;
+        dprintf(job->output_fd, "%s\n", status == 1 ? "Bad command: File not found" : "error: admission queue full, try again later");
+        expire_old_outputs();
+        return status;
+    }
+
+    job->processes_left = job->program_count;
+    job->lines_total = line_count_total;
+    job->state = JOB_RUNNING;
+    running_policy = job->policy;
+    for (int i = 0; i < job->program_count; i++) {
+        PCB *pcb = create_pcb(allocate_pid(), programs[i], programs[i]->line_count);
+        pcb->job_id = job->id;
+        apply_spec(pcb, job->policy, job->tickets);
+        if (admission_submit(pcb, global_queue, job->policy)) {
+            enqueue_arrival(global_queue, pcb, job->policy);
+        }
+        //otherwise admission_run enqueues it once enough frames are free
+    }
+    return 0;
+}
+
+//scheduler is idle, start everything that is waiting with the policy of the oldest waiting job
+static void start_queued_jobs() {
+    int policy = -1;
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i].state != JOB_QUEUED) {
+            continue;
+        }
+        if (policy == -1) {
+            policy = jobs[i].policy;
+        }
+        if (jobs[i].policy == policy) {
+            start_job(&jobs[i]);
+        }
+    }
+}
+
+static void submit(Client *client, char *words[], int word_count) {
+    if (word_count < 3 || word_count - 2 > DAEMON_MAX_PROGRAMS) {
+        reply(client, "ERR usage: SUBMIT POLICY SCRIPT...\n");
+        return;
+    }
+    int tickets;
+    int policy = policy_from_spec(words[1], &tickets);
+    if (policy < 0) {
+        reply(client, "ERR wrong scheduling policy\n");
+        return;
+    }
+
+    char output_path[] = "/tmp/mysh-jobXXXXXX";
+    int output_fd = mkstemp(output_path);
+    if (output_fd < 0) {
+        reply(client, "ERR can't create output file: %s\n", strerror(errno));
+        return;
+    }
+    unlink(output_path);        //nobody else needs to see it, and it goes away with the fd
+
+    if (job_count == job_capacity) {
+        job_capacity = job_capacity ? job_capacity * 2 : 16;
+        jobs = realloc(jobs, job_capacity * sizeof(DaemonJob));
+    }
+    DaemonJob *job = &jobs[job_count++];
+    memset(job, 0, sizeof(*job));
+    job->id = job_count;
+    job->policy = policy;
+    job->tickets = tickets;
+    job->state = JOB_QUEUED;
+    job->output_fd = output_fd;
+    job->program_count = word_count - 2;
+    for (int i = 0; i < job->program_count; i++) {
+        job->paths[i] = strdup(words[i + 2]);
+    }
+
+    //join the running scheduler if it runs our policy (or nothing), otherwise wait for it to drain
+    if (running_policy == -1 || running_policy == policy) {
+        int status = start_job(job);
+        if (status == 1) {
+            reply(client, "ERR %d file not found\n", job->id);
+            return;
+        } else if (status == 2) {
+            reply(client, "BUSY %d admission queue full, try again later\n", job->id);
+            return;
+        }
+    }
+    reply(client, "OK %d\n", job->id);
+}
+
+//clients following a job with WAIT
+static int watching() {
+    int count = 0;
+    for (int i = 0; i < client_count; i++) {
+        count += clients[i].follow;
+    }
+    return count;
+}
+
+//read one request line from a freshly accepted client and queue the answer
+static void handle_client(Client *client) {
+    int fd = client->fd;
+    char request[DAEMON_MAX_REQUEST];
+    size_t len = 0;
+    struct timeval timeout = {.tv_sec = 1 };    //a client that never sends its line can't stall the scheduler for long
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    while (len < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+        if (memchr(request, '\n', len)) {
+            break;
+        }
+    }
+    request[len] = '\0';
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);        //from here on nothing waits for it
+
+    char *words[DAEMON_MAX_PROGRAMS + 2];
+    int word_count = 0;
+    for (char *word = strtok(request, " \t\r\n"); word && word_count < DAEMON_MAX_PROGRAMS + 2; word = strtok(NULL, " \t\r\n")) {
+        words[word_count++] = word;
+    }
+
+    if (word_count == 0) {
+        reply(client, "ERR empty request\n");
+    } else if (strcmp(words[0], "SUBMIT") == 0) {
+        submit(client, words, word_count);
+    } else if (word_count == 2 && (strcmp(words[0], "STATUS") == 0 || strcmp(words[0], "OUTPUT") == 0 || strcmp(words[0], "WAIT") == 0)) {
+        DaemonJob *job = find_job(atoi(words[1]));
+        if (!job) {
+            reply(client, "ERR no such job\n");
+        } else if (strcmp(words[0], "STATUS") == 0) {
+            reply(client, "%d %s %d/%d\n", job->id, job_state_names[job->state], job->lines_done, job->lines_total);
+        } else if (job->output_fd < 0) {
+            reply(client, "ERR output of job %d expired\n", job->id);
+        } else if (strcmp(words[0], "OUTPUT") == 0) {
+            fflush(stdout);
+            client->job_id = job->id;
+            client->end = lseek(job->output_fd, 0, SEEK_END);   //what it printed so far, pread doesn't mind where the offset is
+        } else if (watching() < DAEMON_MAX_WATCHERS) {
+            client->job_id = job->id;
+            client->follow = 1; //the connection stays open until the job is over
+        } else {
+            reply(client, "ERR too many waiting clients\n");
+        }
+    } else {
+        reply(client, "ERR unknown request\n");
+    }
+}
+
+//send clients what they can take, stream new output to WAIT clients, and hang up on the ones that are done
+static void service_clients() {
+    fflush(stdout);             //the running job's output may still be in our buffer
+    for (int i = 0; i < client_count; i++) {
+        if (flush_client(&clients[i])) {
+            close(clients[i].fd);
+            free(clients[i].out);
+            clients[i--] = clients[--client_count];     //swap the last client into this slot and look at it again
+        }
+    }
+}
+
+//accept and answer clients, waiting up to timeout_ms (-1 forever) for a new one or for room in a full socket
+static void daemon_service(int timeout_ms) {
+    struct pollfd pfds[DAEMON_MAX_CLIENTS + 1];
+    int count = 0;
+    if (client_count < DAEMON_MAX_CLIENTS) {
+        pfds[count++] = (struct pollfd) {.fd = listen_fd,.events = POLLIN };
+    }
+    for (int i = 0; i < client_count; i++) {
+        if (clients[i].stuck) {
+            pfds[count++] = (struct pollfd) {.fd = clients[i].fd,.events = POLLOUT };
+        }
+    }
+    if (poll(pfds, count, timeout_ms) > 0 && client_count < DAEMON_MAX_CLIENTS) {
+        int fd;
+        while (client_count < DAEMON_MAX_CLIENTS && (fd = accept(listen_fd, NULL, NULL)) >= 0) {
+            int previous_output = output_job;
+            switch_output(0);   //requests are answered on the socket, keep stray prints out of job output
+            Client *client = &clients[client_count++];
+            *client = (Client) {.fd = fd };
+            handle_client(client);
+            if (previous_output != 0 && find_job(previous_output)->output_fd >= 0) {
+                switch_output(previous_output);
+            }
+        }
+    }
+    service_clients();
+}
+
+//called before every instruction: send output to the right job and keep answering clients
+static void daemon_tick(PCB *pcb) {
+    if (pcb->job_id != output_job) {
+        switch_output(pcb->job_id);
+    }
+    if (!pcb->parent) {         //lines_total only counts the job's own scripts, not what their execs start
+        find_job(pcb->job_id)->lines_done++;
+    }
+
+    uint64_t now = stats_now();
+    if (now - last_service > DAEMON_POLL_INTERVAL_NS) {
+        last_service = now;
+        daemon_service(0);
+    }
+}
+
+//called when a PCB finishes
+static void daemon_exit(PCB *pcb) {
+    if (pcb->parent) {
+        return;                 //started by a job's script, its parent only exits after it
+    }
+    DaemonJob *job = find_job(pcb->job_id);
+    if (--job->processes_left == 0) {
+        fflush(stdout);
+        job->state = JOB_DONE;
+        expire_old_outputs();
+    }
+}
+
+static void remove_socket_and_exit(int sig) {
+    unlink(socket_file);
+    _exit(128 + sig);
+}
+
+int daemon_main(const char *socket_path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "mysh: socket path too long\n");
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+    strcpy(socket_file, socket_path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);        //a socket left behind by an earlier daemon would make bind fail
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        perror("mysh: can't listen on socket");
+        return 1;
+    }
+    fcntl(listen_fd, F_SETFL, O_NONBLOCK);      //accept everything that is pending, then go back to work
+
+    signal(SIGPIPE, SIG_IGN);   //clients hanging up mid-reply must not kill us
+    signal(SIGINT, remove_socket_and_exit);
+    signal(SIGTERM, remove_socket_and_exit);
+
+    saved_stdout = dup(STDOUT_FILENO);
+    scheduler_tick_hook = daemon_tick;
+    scheduler_exit_hook = daemon_exit;
+    global_queue = create_queue();      //one queue for the lifetime of the daemon
+    fprintf(stderr, "mysh: daemon listening on %s\n", socket_path);
+
+    while (1) {
+        if (is_empty(global_queue)) {
+            running_policy = -1;
+            start_queued_jobs();
+        }
+        if (!is_empty(global_queue)) {
+            run_policy(global_queue, running_policy);   //jobs submitted meanwhile join through daemon_tick
+            switch_output(0);
+            service_clients();
+            continue;
+        }
+        daemon_service(-1);     //nothing to run, sleep until a client shows up
+    }
+}
+
+int client_main(const char *socket_path, int argc, char *argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: mysh --client SOCKET SUBMIT POLICY SCRIPT... | STATUS ID | OUTPUT ID | WAIT ID\n");
+        return 1;
+    }
+
+    //the daemon has its own working directory, so scripts are sent as absolute paths
+    char request[DAEMON_MAX_REQUEST] = "";
+    for (int i = 0; i < argc; i++) {
+        char resolved[PATH_MAX];
+        const char *word = argv[i];
+        if (strcmp(argv[0], "SUBMIT") == 0 && i >= 2 && realpath(word, resolved)) {
+            word = resolved;
+        }
+        if (strlen(request) + strlen(word) + 2 >= sizeof(request)) {
+            fprintf(stderr, "mysh: request too long\n");
+            return 1;
+        }
+        strcat(request, word);
+        strcat(request, i + 1 < argc ? " " : "\n");
+    }
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX };
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        perror("mysh: can't connect to daemon");
+        return 1;
+    }
+    send_all(fd, request, strlen(request));
+    shutdown(fd, SHUT_WR);
+
+    char buf[8192];
+    ssize_t n;
+    int failed = -1;            //decided by the first bytes of the reply
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        if (failed == -1) {
+            failed = (n >= 3 && strncmp(buf, "ERR", 3) == 0) || (n >= 4 && strncmp(buf, "BUSY", 4) == 0);
+        }
+        fwrite(buf, 1, n, stdout);
+    }
+    close(fd);
+    return failed == 1;
+}
@@ -0,0 +1,18 @@
+#ifndef DAEMON_H
+#   define DAEMON_H
+
+//Daemon mode: mysh --daemon SOCKET keeps one scheduler and one program memory alive
+//and takes job submissions from clients over a Unix domain socket.
+//Requests are single lines, one per connection:
+//  SUBMIT POLICY SCRIPT...   -> "OK <job id>", "ERR <reason>", or "BUSY" when the admission queue is full
+//  STATUS ID                 -> "<job id> QUEUED|RUNNING|DONE|FAILED <instructions run>/<total>"
+//  OUTPUT ID                 -> everything the job has printed so far
+//  WAIT ID                   -> streams the job's output until it finishes
+//POLICY is any exec policy, STRIDE:TICKETS or LOTTERY:TICKETS give the job a share of the CPU
+//relative to the other jobs running with the same policy.
+//mysh --client SOCKET REQUEST... sends one request and prints the reply.
+
+int daemon_main(const char *socket_path);       //run as a daemon, only returns if the socket can't be set up
+int client_main(const char *socket_path, int argc, char *argv[]);       //send one request, returns 0 unless the daemon said ERR or BUSY
+
+#endif
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dag.h"
+#include "admission.h"
+#include "jobs.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "shellmemory.h"
+#include "stats.h"
+
+//one script in the dag
+typedef struct DagNode {
+    char name[MAX_PROGRAM_LINE_LENGTH];
+    PCB *pcb;                   //NULL once it has been released, the scheduler owns it from then on
+    int pid;
+    int lines;
+    int preds[DAG_MAX_NODES];   //indexes of the scripts it waits for
+    int pred_count;
+    int remaining;              //predecessors that haven't finished yet
+    uint64_t finished_at;       //stats_now() when its last instruction ran
+    long longest;               //instructions on the longest path that ends with this script
+    int longest_pred;           //predecessor on that path, -1 for none
+} DagNode;
+
+static DagNode nodes[DAG_MAX_NODES];
+static int node_count = 0;      //0 when no dag is running
+static int dag_policy;
+static void (*outer_exit_hook)(PCB * pcb);      //whoever had scheduler_exit_hook before the dag
+
+//hand a script whose predecessors are all done to the scheduler
+static void release(DagNode *node) {
+    PCB *pcb = node->pcb;
+    node->pcb = NULL;
+    if (admission_submit(pcb, global_queue, dag_policy)) {
+        enqueue_arrival(global_queue, pcb, dag_policy);
+    }
+    //otherwise admission_run enqueues it once enough frames are free
+}
+
+//a process finished, release whatever was only waiting for it
+static void dag_exit(PCB *pcb) {
+    if (outer_exit_hook) {
+        outer_exit_hook(pcb);
+    }
+    int done = -1;
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].pid == pcb->pid) {
+            done = i;
+        }
+    }
+    if (done < 0) {
+        return;                 //not one of ours, e.g. the batch script
+    }
+    nodes[done].finished_at = stats_now();
+    for (int i = done + 1; i < node_count; i++) {       //only later scripts can depend on it
+        for (int j = 0; j < nodes[i].pred_count; j++) {
+            if (nodes[i].preds[j] == done && --nodes[i].remaining == 0) {
+                release(&nodes[i]);
+            }
+        }
+    }
+}
+
+static int find_node(const char *name, int before) {
+    for (int i = 0; i < before; i++) {
+        if (strcmp(nodes[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//fill in nodes from the SCRIPT[:DEP,DEP...] arguments
+static int parse_specs(char *specs[], int spec_count) {
+    for (int i = 0; i < spec_count; i++) {
+        DagNode *node = &nodes[i];
+        memset(node, 0, sizeof(DagNode));
+        node->longest_pred = -1;
+
+        char spec[MAX_PROGRAM_LINE_LENGTH];
+        snprintf(spec, sizeof(spec), "%s", specs[i]);
+        char *deps = strchr(spec, ':');
+        if (deps) {
+            *deps++ = '\0';
+        }
+        snprintf(node->name, sizeof(node->name), "%s", spec);
+        if (node->name[0] == '\0' || find_node(node->name, i) >= 0) {
+            return DAG_BAD_SPEC;
+        }
+
+        for (char *dep = deps ? strtok(deps, ",") : NULL; dep; dep = strtok(NULL, ",")) {
+            int pred = find_node(dep, i);
+            if (pred < 0) {
+                return DAG_BAD_SPEC;
+            }
+            node->preds[node->pred_count++] = pred;
+        }
+        node->remaining = node->pred_count;
+    }
+    return 0;
+}
+
+static void print_path(int last) {
+    int path[DAG_MAX_NODES], length = 0;
+    for (int i = last; i >= 0; i = nodes[i].longest_pred) {
+        path[length++] = i;
+    }
+    for (int i = length - 1; i >= 0; i--) {
+        printf("%s%s", nodes[path[i]].name, i > 0 ? " -> " : "");
+    }
+}
+
+//critical path: walk back from the script that finished last through the predecessor each one
+//waited for longest. Longest path: the same walk over instruction counts, the best any
+//schedule could do with every branch running at once.
+static void print_report(uint64_t started) {
+    int last = 0, longest = 0;
+    for (int i = 0; i < node_count; i++) {
+        for (int j = 0; j < nodes[i].pred_count; j++) {
+            int pred = nodes[i].preds[j];
+            if (nodes[pred].longest > nodes[i].longest) {
+                nodes[i].longest = nodes[pred].longest;
+                nodes[i].longest_pred = pred;
+            }
+        }
+        nodes[i].longest += nodes[i].lines;
+        if (nodes[i].longest > nodes[longest].longest) {
+            longest = i;
+        }
+        if (nodes[i].finished_at > nodes[last].finished_at) {
+            last = i;
+        }
+    }
+    printf("longest path: ");
+    print_path(longest);
+    printf(", %ld instructions\n", nodes[longest].longest);
+
+    //reuse longest_pred for the critical path now that the longest path is printed
+    for (int i = 0; i < node_count; i++) {
+        nodes[i].longest_pred = -1;
+        for (int j = 0; j < nodes[i].pred_count; j++) {
+            int pred = nodes[i].preds[j];
+            if (nodes[i].longest_pred < 0 || nodes[pred].finished_at > nodes[nodes[i].longest_pred].finished_at) {
+                nodes[i].longest_pred = pred;
+            }
+        }
+    }
+    printf("critical path: ");
+    print_path(last);
+    printf(", %.3fms\n", (nodes[last].finished_at - started) / 1e6);
+}
+
+int dag_exec(char *specs[], int spec_count, int policy, int tickets) {
+    if (spec_count > DAG_MAX_NODES) {
+        return DAG_TOO_BIG;
+    }
+    if (node_count > 0) {       //a script of a running dag started another one
+        return DAG_BUSY;
+    }
+    int status = parse_specs(specs, spec_count);
+    if (status != 0) {
+        return status;
+    }
+
+    //open every script first, so a missing file leaves nothing behind
+    BackingStore *programs[DAG_MAX_NODES];
+    for (int i = 0; i < spec_count; i++) {
+        programs[i] = backing_open(nodes[i].name);
+        if (!programs[i]) {
+            for (int j = 0; j < i; j++) {
+                backing_close(programs[j]);
+            }
+            return DAG_NO_FILE;
+        }
+    }
+    if (!admission_has_room(spec_count)) {
+        for (int i = 0; i < spec_count; i++) {
+            backing_close(programs[i]);
+        }
+        return DAG_BUSY;
+    }
+
+    for (int i = 0; i < spec_count; i++) {
+        nodes[i].lines = programs[i]->line_count;
+        nodes[i].pcb = create_pcb(allocate_pid(), programs[i], programs[i]->line_count);
+        nodes[i].pid = nodes[i].pcb->pid;
+        apply_spec(nodes[i].pcb, policy, tickets);
+    }
+    node_count = spec_count;
+    dag_policy = policy;
+    outer_exit_hook = scheduler_exit_hook;
+    scheduler_exit_hook = dag_exit;
+
+    if (!global_queue) {
+        global_queue = create_queue();
+    }
+    uint64_t started = stats_now();
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].remaining == 0) {  //no predecessors, it can start right away
+            release(&nodes[i]);
+        }
+    }
+    run_foreground(global_queue, policy);       //released scripts join the queue while it runs
+
+    scheduler_exit_hook = outer_exit_hook;
+    print_report(started);
+    node_count = 0;
+
+    destroy_queue(global_queue);        //free queue struct
+    global_queue = NULL;
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef DAG_H
+#   define DAG_H
+
+//Dependency aware exec: dag SCRIPT[:DEP,DEP...]... POLICY
+//Each script may name scripts earlier in the list that have to finish before it starts, e.g.
+//  dag a b:a c:a d:b,c RR
+//runs a, then b and c side by side under RR, then d once both are done.
+//A script's PCB only reaches the ready queue when its last predecessor finishes.
+//Afterwards the critical path (the chain of scripts that actually held up the end) and the
+//longest path in instructions are printed.
+
+#   define DAG_MAX_NODES 16     //scripts in one dag
+
+//dag_exec results other than 0
+enum {
+    DAG_NO_FILE = 1,            //a script doesn't exist
+    DAG_BAD_SPEC,               //a dependency names a script that isn't earlier in the list, or a script is listed twice
+    DAG_TOO_BIG,                //more than DAG_MAX_NODES scripts
+    DAG_BUSY,                   //the admission queue is full, or a dag is already running
+};
+
+int dag_exec(char *specs[], int spec_count, int policy, int tickets);   //run the scripts, returns 0 or a DAG_* error
+
+#endif
@@ -0,0 +1,411 @@
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "decisions.h"
+#include "admission.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "stats.h"
+
+#define LOG_MAGIC "MYSHDEC1"    //also the format version, change it when the layout changes
+#define LOG_BUFFER_SIZE (1 << 20)       //decisions are written a buffer at a time
+#define MAX_PROCESS_NUMBER (1 << 20)    //a run whose processes' pids are further apart than this is refused
+
+typedef struct Decision {
+    uint32_t kind;              //DECISION_*
+    int32_t process;            //pid counted from the run's first, -1 if it isn't about a process
+    int64_t value;
+    uint64_t time_ns;           //since the run started
+} Decision;
+
+//follows a DECISION_RUN record
+typedef struct RunHeader {
+    int32_t policy;             //POLICY_* the run used
+    int32_t process_count;
+    int32_t sorted;             //the queue was already in SJF order, see ReadyQueue
+    int32_t reserved;           //keeps the 64 bit fields aligned
+    int64_t queue_pass;         //STRIDE virtual time
+    uint64_t lottery_state;
+} RunHeader;
+
+//follows the run header once per process, then text_length bytes of script, see backing_copy
+typedef struct RunProcess {
+    int32_t process;            //pid counted from the run's first
+    int32_t pc;
+    int32_t number_of_lines;
+    int32_t job_length_score;   //with the aging it got while it waited applied
+    int32_t is_batch_script;
+    int32_t tickets;
+    int32_t text_length;
+    int32_t relative_deadline;  //EDF, the replay counts it from when the run is rebuilt
+    int64_t pass;
+} RunProcess;
+
+static const char *kind_names[DECISION_KIND_COUNT] = {
+    "run", "dispatch", "slice end", "requeue", "age", "admit", "wait", "block", "finish", "end", "auto"
+};
+
+int decisions_on = 0;
+static int depth = 0;           //run_foreground calls in progress, only the outermost is logged
+static int logging_run = 0;     //the outermost run is being logged or compared
+static int base_pid;            //pid process 0 of the run has
+static uint64_t run_start;      //stats_now() when the run started
+
+//recording
+static FILE *log_file = NULL;
+static char *log_path = NULL;
+
+//replaying
+static int replaying = 0;
+static char *log_map;           //the whole log, mapped
+static size_t log_size;
+static const char *at;          //next record to read
+static int run_number;
+static int matched;             //decisions of the run that were the same as recorded
+static int diverged;            //the run went another way, it isn't compared any further
+static uint64_t replayed_ns;    //how long the run took this time
+
+//the text goes first and its length is filled in afterwards, so the script is only read once
+static int write_process(PCB *pcb, int score) {
+    RunProcess record = {
+        .process = pcb->pid - base_pid,
+        .pc = pcb->pc,
+        .number_of_lines = pcb->number_of_lines,
+        .job_length_score = score,
+        .is_batch_script = pcb->is_batch_script,
+        .tickets = pcb->tickets,
+        .relative_deadline = pcb->relative_deadline,
+        .pass = pcb->pass,
+    };
+    long start = ftell(log_file);
+    if (fwrite(&record, sizeof(record), 1, log_file) != 1) {
+        return -1;
+    }
+    long length = backing_copy(pcb->backing, log_file);
+    if (length < 0 || length > INT32_MAX) {
+        return -1;
+    }
+    record.text_length = length;
+    if (fseek(log_file, start, SEEK_SET) != 0 || fwrite(&record, sizeof(record), 1, log_file) != 1) {
+        return -1;
+    }
+    return fseek(log_file, 0, SEEK_END);
+}
+
+//the run header and every process the run starts out with: the queue and the programs that
+//will join it once they get frames
+static int write_run(ReadyQueue *queue, int policy) {
+    PCB *waiting[ADMISSION_MAX_PENDING];
+    int waiting_count = admission_waiting(queue, waiting, ADMISSION_MAX_PENDING);
+    RunHeader header = {
+        .policy = policy,
+        .process_count = queue->size + waiting_count,
+        .sorted = queue->sorted,
+        .queue_pass = queue->pass,
+        .lottery_state = lottery_state,
+    };
+    base_pid = INT_MAX;         //the lowest pid of the run
+    for (PCB * pcb = queue->head; pcb; pcb = pcb->next) {
+        base_pid = pcb->pid < base_pid ? pcb->pid : base_pid;
+    }
+    for (int i = 0; i < waiting_count; i++) {
+        base_pid = waiting[i]->pid < base_pid ? waiting[i]->pid : base_pid;
+    }
+
+    Decision decision = {.kind = DECISION_RUN,.process = -1 };
+    int failed = fwrite(&decision, sizeof(decision), 1, log_file) != 1
+        || fwrite(&header, sizeof(header), 1, log_file) != 1;
+    for (PCB * pcb = queue->head; pcb && !failed; pcb = pcb->next) {
+        failed = write_process(pcb, queued_score(queue, pcb));
+    }
+    for (int i = 0; i < waiting_count && !failed; i++) {
+        failed = write_process(waiting[i], waiting[i]->job_length_score);
+    }
+    return failed ? -1 : 0;
+}
+
+//a log that can't be written to any more is closed, what is in it so far stays readable
+static void stop_recording() {
+    printf("error: can't write decision log %s, recording stopped\n", log_path);
+    decisions_record(NULL);
+}
+
+int decisions_record(const char *path) {
+    if (log_file) {
+        fclose(log_file);
+        log_file = NULL;
+        free(log_path);
+        log_path = NULL;
+    }
+    if (!replaying) {
+        logging_run = 0;        //a run that is going stays unlogged
+        decisions_on = 0;
+    }
+    if (!path) {
+        return 0;
+    }
+    log_file = fopen(path, "wb");
+    if (!log_file) {
+        return -1;
+    }
+    setvbuf(log_file, NULL, _IOFBF, LOG_BUFFER_SIZE);
+    if (fwrite(LOG_MAGIC, 8, 1, log_file) != 1) {
+        fclose(log_file);
+        log_file = NULL;
+        return -1;
+    }
+    log_path = strdup(path);
+    return 0;
+}
+
+void decisions_run_start(ReadyQueue *queue, int policy) {
+    if (depth++ > 0) {
+        decisions_on = 0;       //a line typed in the middle of the run started a run of its own
+        return;
+    }
+    if (replaying) {
+        logging_run = 1;        //replay_next_run set everything else up
+    } else if (log_file) {
+        if (write_run(queue, policy) != 0) {
+            stop_recording();
+            return;
+        }
+        logging_run = 1;
+    }
+    decisions_on = logging_run;
+    run_start = stats_now();
+}
+
+void decisions_run_end() {
+    if (--depth > 0) {
+        decisions_on = depth == 1 && logging_run;
+        return;
+    }
+    if (!logging_run) {
+        return;
+    }
+    if (replaying) {
+        replayed_ns = stats_now() - run_start;
+    } else {
+        log_decision(DECISION_END, NULL, 0);
+        if (log_file && fflush(log_file) != 0) {    //a finished run is on disk even if the shell dies later
+            stop_recording();
+        }
+    }
+    logging_run = 0;
+    decisions_on = 0;
+}
+
+//the next recorded decision, without moving past it, 0 if the log ends first
+static int peek_decision(Decision *decision) {
+    if ((size_t) (log_map + log_size - at) < sizeof(Decision)) {
+        return 0;
+    }
+    memcpy(decision, at, sizeof(Decision));     //records in the file aren't aligned
+    return 1;
+}
+
+static void print_divergence(const Decision *recorded, const Decision *replayed) {
+    printf("replay: run %d diverges at decision %d: recorded %s", run_number, matched + 1,
+           kind_names[recorded->kind]);
+    if (recorded->process >= 0) {
+        printf(" process %d", recorded->process);
+    }
+    printf(" value %ld at %.3f ms, replayed %s", (long) recorded->value, recorded->time_ns / 1e6,
+           kind_names[replayed->kind]);
+    if (replayed->process >= 0) {
+        printf(" process %d", replayed->process);
+    }
+    printf(" value %ld at %.3f ms\n", (long) replayed->value, replayed->time_ns / 1e6);
+}
+
+static void compare_decision(const Decision *replayed) {
+    if (diverged) {
+        return;
+    }
+    Decision recorded;
+    if (!peek_decision(&recorded) || recorded.kind >= DECISION_KIND_COUNT) {
+        recorded = (Decision) {
+        .kind = DECISION_END,.process = -1};
+    }
+    if (recorded.kind != DECISION_END) {
+        at += sizeof(Decision); //the end stays for replay_end_run to find
+    }
+    if (recorded.kind != replayed->kind || recorded.process != replayed->process
+        || recorded.value != replayed->value) {
+        print_divergence(&recorded, replayed);
+        diverged = 1;
+        return;
+    }
+    matched++;
+}
+
+void log_decision(int kind, PCB *pcb, long value) {
+    if (!decisions_on) {
+        return;
+    }
+    Decision decision = {
+        .kind = kind,
+        .process = pcb ? pcb->pid - base_pid : -1,
+        .value = value,
+        .time_ns = stats_now() - run_start,
+    };
+    if (replaying) {
+        compare_decision(&decision);
+    } else if (fwrite(&decision, sizeof(decision), 1, log_file) != 1) {
+        stop_recording();
+    }
+}
+
+int replay_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return REPLAY_NO_FILE;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 8) {
+        close(fd);
+        return REPLAY_CORRUPT;
+    }
+    log_map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                  //the mapping keeps the file
+    if (log_map == MAP_FAILED) {
+        return REPLAY_NO_FILE;
+    }
+    log_size = info.st_size;
+    if (memcmp(log_map, LOG_MAGIC, 8) != 0) {
+        munmap(log_map, log_size);
+        return REPLAY_CORRUPT;
+    }
+    at = log_map + 8;
+    run_number = 0;
+    replaying = 1;
+    logging_run = 0;
+    decisions_on = 0;
+    return 0;
+}
+
+//copy out the next size bytes of the log, 0 if it is cut short
+static int take_record(void *record, size_t size) {
+    if ((size_t) (log_map + log_size - at) < size) {
+        return 0;
+    }
+    memcpy(record, at, size);
+    at += size;
+    return 1;
+}
+
+//index every process's script, before anything is created so a damaged run replays nothing
+static int read_processes(int count, RunProcess records[], BackingStore *programs[]) {
+    for (int i = 0; i < count; i++) {
+        RunProcess *record = &records[i];
+        FILE *stream = NULL;
+        programs[i] = NULL;
+        if (take_record(record, sizeof(*record)) && record->text_length > 0
+            && (size_t) (log_map + log_size - at) >= (size_t) record->text_length
+            && record->tickets >= 1 && record->tickets <= STRIDE1 && record->pc >= 0
+            && record->relative_deadline >= 0 && record->relative_deadline <= EDF_MAX_DEADLINE
+            && record->process >= 0 && record->process < MAX_PROCESS_NUMBER) {
+            stream = fmemopen((void *) at, record->text_length, "r");
+            at += record->text_length;
+        }
+        if (stream) {
+            programs[i] = backing_from_stream(stream);  //the mapping goes away, the script needs a file of its own
+            fclose(stream);
+        }
+        if (!programs[i] || programs[i]->line_count != record->number_of_lines
+            || record->pc >= record->number_of_lines) {
+            for (int j = 0; j <= i; j++) {
+                backing_close(programs[j]);
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int replay_next_run(int *policy) {
+    if (at == log_map + log_size) {
+        return 0;
+    }
+    Decision decision;
+    RunHeader header;
+    if (!take_record(&decision, sizeof(decision)) || decision.kind != DECISION_RUN
+        || !take_record(&header, sizeof(header)) || header.policy < 0 || header.policy >= POLICY_COUNT
+        || header.process_count < 0 || header.process_count > ADMISSION_MAX_PENDING
+        || !admission_has_room(header.process_count)) {
+        return -1;
+    }
+    RunProcess records[header.process_count + 1];
+    BackingStore *programs[header.process_count + 1];
+    if (!read_processes(header.process_count, records, programs)) {
+        return -1;
+    }
+
+    //take as many pids as the run had, so the processes get the same numbers and their
+    //children, which get the pids after them, do too
+    int last = 0;
+    for (int i = 0; i < header.process_count; i++) {
+        if (records[i].process > last) {
+            last = records[i].process;
+        }
+    }
+    base_pid = allocate_pid();
+    for (int i = 0; i < last; i++) {
+        allocate_pid();
+    }
+
+    global_queue = create_queue();
+    global_queue->pass = header.queue_pass;
+    if (header.lottery_state) {
+        lottery_state = header.lottery_state;
+    }
+    for (int i = 0; i < header.process_count; i++) {
+        PCB *pcb = create_pcb(base_pid + records[i].process, programs[i], records[i].number_of_lines);
+        pcb->pc = records[i].pc;
+        pcb->job_length_score = records[i].job_length_score;
+        pcb->is_batch_script = records[i].is_batch_script;
+        pcb_set_tickets(pcb, records[i].tickets);
+        pcb_set_deadline(pcb, records[i].relative_deadline);
+        pcb->pass = records[i].pass;
+        if (admission_submit(pcb, global_queue, header.policy)) {
+            enqueue(global_queue, pcb);
+        }
+    }
+    global_queue->sorted = header.sorted;
+    run_number++;
+    matched = 0;
+    diverged = 0;
+    *policy = header.policy;
+    return 1;
+}
+
+void replay_end_run() {
+    Decision recorded;
+    if (!diverged && peek_decision(&recorded) && recorded.kind != DECISION_END) {
+        Decision replayed = {.kind = DECISION_END,.process = -1,.time_ns = replayed_ns };
+        print_divergence(&recorded, &replayed);
+        diverged = 1;
+    }
+    //skip whatever the replay didn't get to, up to the end of the run
+    uint64_t recorded_ns = 0;
+    while (take_record(&recorded, sizeof(recorded))) {
+        if (recorded.kind == DECISION_END) {
+            recorded_ns = recorded.time_ns;
+            break;
+        }
+    }
+    double change = recorded_ns ? 100.0 * ((double) replayed_ns - recorded_ns) / recorded_ns : 0;
+    printf("replay: run %d %s after %d decisions, recorded %.3f ms, replayed %.3f ms (%+.1f%%)\n",
+           run_number, diverged ? "diverged" : "matched", matched, recorded_ns / 1e6, replayed_ns / 1e6, change);
+}
+
+void replay_close() {
+    munmap(log_map, log_size);
+    replaying = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef DECISIONS_H
+#   define DECISIONS_H
+
+#   include <stdint.h>
+#   include "pcb.h"
+#   include "readyqueue.h"
+
+//Decision log: a compact binary record of every scheduling decision of foreground runs (exec,
+//source, dag, restore), for reproducing scheduler behaviour and comparing scheduler changes.
+//  record PATH     log every foreground run from now on to PATH, replacing it
+//  record off      stop logging
+//  replay PATH     run every logged run again under this build and compare its decisions
+//A logged run starts with the policy, the lottery state and every process of the queue (pc,
+//score, tickets, script text), so replay needs nothing but the log. After that come fixed size
+//decision records, each with the time since the run started. Processes are numbered by pid
+//counting from the run's first, so a replay matches them up however many pids went before.
+//replay stops comparing a run at its first divergence and prints the recorded and replayed
+//decision and times, then prints for every run how many decisions matched and how long it took
+//then and now. Scripts run for real while they are replayed, their output and side effects too.
+//Lines typed at a terminal in the middle of a run are not part of the log, neither are runs they
+//start, so a recorded run that was interrupted replays without them.
+
+//what a decision record is about
+enum {
+    DECISION_RUN,               //a run starts, the run header and its processes follow
+    DECISION_DISPATCH,          //a process was taken from the queue, value is its pc
+    DECISION_SLICE_END,         //it stopped running, value is its pc
+    DECISION_REQUEUE,           //it went back in the queue, value is its position (its pass under STRIDE)
+    DECISION_AGE,               //the waiting processes were aged, value is the queue's aging total
+    DECISION_ADMIT,             //a program got frames, value is its number of lines
+    DECISION_WAIT,              //a program has to wait for frames, value is its number of lines
+    DECISION_BLOCK,             //it waits for its children
+    DECISION_FINISH,            //its program is over, value is EXITED_*
+    DECISION_END,               //the run is over
+    DECISION_AUTO,              //AUTO looked at the queue, value is its AUTO_* strategy times 256 plus its quantum
+    DECISION_KIND_COUNT
+};
+
+//replay_open results other than 0
+enum {
+    REPLAY_NO_FILE = 1,         //the log can't be opened
+    REPLAY_CORRUPT,             //it isn't a decision log
+};
+
+extern int decisions_on;        //a foreground run is being logged or compared, checked before working out what to log
+
+int decisions_record(const char *path); //log runs to path, NULL stops, returns 0 or -1
+void decisions_run_start(ReadyQueue * queue, int policy);       //run_foreground is about to run queue
+void decisions_run_end();       //and is done with it
+void log_decision(int kind, PCB * pcb, long value);     //log or compare a decision about pcb (NULL if it isn't about one)
+
+int replay_open(const char *path);      //map a log for replay, returns 0 or a REPLAY_* error
+int replay_next_run(int *policy);       //put the next logged run's processes in global_queue, returns 0 when there are no more, -1 if the log is damaged
+void replay_end_run();          //print how the run that was just replayed compared
+void replay_close();
+
+#endif
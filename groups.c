@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include "groups.h"
+#include "scheduler.h"
+
+int group_quantum = 10;
+
+static Group groups[GROUPS_MAX];
+static int group_count = 0;     //groups[0] is the default group once anything asked for a group
+static long virtual_pass = 0;   //pass of the group that ran last
+
+static Group *add_group(const char *name, int weight, int policy) {
+    Group *group = &groups[group_count++];
+    snprintf(group->name, sizeof(group->name), "%s", name);
+    group->weight = weight;
+    group->policy = policy;
+    group->queue = create_queue();
+    group->pass = virtual_pass;
+    group->instructions = 0;
+    return group;
+}
+
+Group *group_default() {
+    if (group_count == 0) {
+        add_group("default", DEFAULT_WEIGHT, POLICY_FCFS);
+    }
+    return &groups[0];
+}
+
+Group *group_find(const char *name) {
+    for (int i = 1; i < group_count; i++) {
+        if (strcmp(groups[i].name, name) == 0) {
+            return &groups[i];
+        }
+    }
+    return NULL;
+}
+
+int group_define(const char *name, int weight, int policy) {
+    group_default();
+    Group *group = group_find(name);
+    if (!group) {
+        if (group_count == GROUPS_MAX) {
+            return 1;
+        }
+        group = add_group(name, weight, policy);
+    }
+    group->weight = weight;
+    if (group->policy != policy) {
+        group->policy = policy;
+        group->queue->sorted = 0;       //SJF and AGING have to put it in their order again
+    }
+    return 0;
+}
+
+int groups_with_work() {
+    int busy = 0;
+    for (int i = 0; i < group_count; i++) {
+        busy += !is_empty(groups[i].queue);
+    }
+    return busy;
+}
+
+int groups_queued() {
+    int queued = 0;
+    for (int i = 0; i < group_count; i++) {
+        queued += groups[i].queue->size;
+    }
+    return queued;
+}
+
+Group *group_next() {
+    Group *next = NULL;
+    for (int i = 0; i < group_count; i++) {
+        Group *group = &groups[i];
+        if (is_empty(group->queue)) {
+            continue;
+        }
+        if (group->pass < virtual_pass) {       //it was idle, it gets no credit for that
+            group->pass = virtual_pass;
+        }
+        if (!next || group->pass < next->pass) {
+            next = group;
+        }
+    }
+    if (next) {
+        virtual_pass = next->pass;
+    }
+    return next;
+}
+
+void group_charge(Group *group, int instructions) {
+    group->pass += (long) instructions *(STRIDE1 / group->weight);
+    group->instructions += instructions;
+}
+
+void groups_print() {
+    printf("%-16s %8s %8s %8s %12s\n", "GROUP", "WEIGHT", "POLICY", "QUEUED", "INSTRUCTIONS");
+    for (int i = 0; i < group_count; i++) {
+        Group *group = &groups[i];
+        printf("%-16s %8d %8s %8d %12llu\n", group->name, group->weight, policy_name(group->policy),
+               group->queue->size, (unsigned long long) group->instructions);
+    }
+}
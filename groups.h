@@ -0,0 +1,41 @@
+#ifndef GROUPS_H
+#   define GROUPS_H
+
+#   include <stdint.h>
+#   include "readyqueue.h"
+
+//Scheduling groups: background jobs can be submitted to a named group instead of a policy,
+//  group NAME WEIGHT POLICY    create a group, or change its weight and policy
+//  group                       list groups
+//  exec SCRIPT... NAME [&]     run the scripts in group NAME, without & it waits for them
+//Every group has its own ready queue run by its own policy. When more than one group has work,
+//the group with the lowest pass runs group_quantum instructions and its pass then moves on by
+//STRIDE1 / weight per instruction, so groups share the CPU in proportion to their weights
+//however many jobs each one submits. Background jobs submitted with a plain policy are in
+//the default group, whose policy is whatever its running jobs asked for.
+
+#   define GROUPS_MAX 16        //groups including the default one
+#   define GROUP_NAME_LENGTH 32
+#   define DEFAULT_WEIGHT 100   //weight of the default group and of a group that doesn't give one
+
+typedef struct Group {
+    char name[GROUP_NAME_LENGTH];
+    int weight;
+    int policy;                 //POLICY_* its queue is run with
+    ReadyQueue *queue;
+    long pass;                  //lowest pass runs next
+    uint64_t instructions;      //instructions its processes ran
+} Group;
+
+extern int group_quantum;       //instructions a group runs before the next group gets a turn, 10
+
+Group *group_default();         //group for background jobs submitted with a policy
+Group *group_find(const char *name);    //NULL if there is no such group
+int group_define(const char *name, int weight, int policy);     //0 on success, 1 if there are already GROUPS_MAX groups
+Group *group_next();            //group with work and the lowest pass, NULL if no group has work
+int groups_with_work();         //how many groups have PCBs queued
+int groups_queued();            //PCBs queued in all groups together
+void group_charge(Group * group, int instructions);     //move a group's pass on for instructions it ran
+void groups_print();
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+#include "shell.h"
+
+#define PIECE (MAX_USER_INPUT - 2)      //most characters fgets(MAX_USER_INPUT - 1) returns at once
+
+static int input_fd = -1;
+static char *data;              //the mapped file, or the read buffer
+static size_t start, end;       //unread input is data[start, end)
+static int mapped;              //data is the whole file, there is nothing more to read
+static int at_eof;              //read returned 0, or data is mapped
+static char piece[PIECE + 1];   //a line that can't be handed out in place, terminated
+
+void input_open(int fd) {
+    input_fd = fd;
+    struct stat info;
+    off_t offset = lseek(fd, 0, SEEK_CUR);      //whoever started the shell may have read part of it
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            lseek(fd, 0, SEEK_END);     //the shell has it all now
+            mapped = at_eof = 1;
+            start = offset;
+            end = info.st_size;
+            return;
+        }
+    }
+    data = malloc(INPUT_BLOCK);
+    start = end = 0;
+}
+
+//move what is left to the front of the buffer and read more after it
+static void fill() {
+    memmove(data, data + start, end - start);
+    end -= start;
+    start = 0;
+    ssize_t got;
+    do {
+        got = read(input_fd, data + end, INPUT_BLOCK - end);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) {
+        at_eof = 1;
+    } else {
+        end += got;
+    }
+}
+
+char *input_next_line() {
+    for (;;) {
+        size_t length = end - start < PIECE ? end - start : PIECE;
+        char *newline = memchr(data + start, '\n', length);
+        if (newline) {          //parseInput stops at the newline, the line can stay where it is
+            char *line = data + start;
+            start = newline + 1 - data;
+            return line;
+        }
+        if (length == PIECE || at_eof) {
+            break;
+        }
+        fill();
+    }
+    if (start == end) {
+        return NULL;
+    }
+    size_t length = end - start < PIECE ? end - start : PIECE;
+    memcpy(piece, data + start, length);
+    piece[length] = '\0';
+    start += length;
+    return piece;
+}
+
+FILE *input_rest() {
+    FILE *rest = NULL;
+    if (mapped && end > start) {
+        rest = fmemopen(data + start, end - start, "r");        //the mapping stays as long as the shell does
+    }
+    if (!rest && (rest = tmpfile())) {
+        fwrite(data + start, 1, end - start, rest);
+        char block[1 << 16];
+        ssize_t got;
+        while (!at_eof && (got = read(input_fd, block, sizeof(block))) != 0) {
+            if (got > 0) {
+                fwrite(block, 1, got, rest);
+            } else if (errno != EINTR) {
+                break;
+            }
+        }
+        rewind(rest);
+    }
+    start = end;
+    at_eof = 1;
+    return rest;
+}
@@ -0,0 +1,20 @@
+#ifndef INPUT_H
+#   define INPUT_H
+
+#   include <stdio.h>
+
+//Batch input: when stdin isn't a terminal the shell reads it in big blocks instead of a line
+//at a time. A regular file is mapped whole, anything else (a pipe) is read INPUT_BLOCK bytes at
+//a time into one buffer, and lines are handed out where they are, without copying or clearing
+//a line buffer. A line comes out the way fgets(MAX_USER_INPUT - 1) would have returned it:
+//ending in its newline, and lines of MAX_USER_INPUT - 2 characters or more in pieces of that
+//size, which, like a last line without a newline, are copied out so they can be terminated.
+//Programs started by run see the mapped file as read to the end, like input stdio buffered.
+
+#   define INPUT_BLOCK (1 << 20)        //bytes read from a pipe at once
+
+void input_open(int fd);        //read batch input from fd from now on
+char *input_next_line();        //the next line, valid until the next call, NULL at the end of input
+FILE *input_rest();             //a stream with all the input not handed out yet, for the caller to close, input is at its end afterwards
+
+#endif
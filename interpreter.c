@@ -13,16 +13,33 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>              // tolower, isdigit
-#include <dirent.h>             // scandir
 #include <unistd.h>             // chdir
 #include <sys/stat.h>           // mkdir
 // for run:
 #include <sys/types.h>          // pid_t
 #include <sys/wait.h>           // waitpid
+#include <sys/resource.h>       // wait4 rusage
+#include <errno.h>
 
 #include "shellmemory.h"
 #include "shell.h"
+#include "interpreter.h"
 #include "scheduler.h"          //for helper function used in source()
+#include "stats.h"              //latency histograms
+#include "admission.h"          //exec waits for program memory instead of failing
+#include "paging.h"             //scripts are loaded a page at a time
+#include "dag.h"                //exec with dependencies between scripts
+#include "jobs.h"               //exec ... & runs in the background
+#include "groups.h"             //weighted shares between background jobs
+#include "checkpoint.h"         //snapshots to resume a run after a restart
+#include "metrics.h"            //counters for scraping
+#include "listing.h"            //my_ls
+#include "decisions.h"          //scheduling decision log and replay
+#include "input.h"              //the rest of the batch input for exec #
+#include "spawn.h"              //starting programs for run
+#include "workers.h"            //exec on worker processes
+#include "quotas.h"             //per process accounting and limits
+#include "scopes.h"             //variables of background jobs
 
 int badcommand() {
     printf("Unknown Command\n");
@@ -58,6 +75,24 @@ int source(char *script);
 int run(char *args[], int args_size);
 int badcommandFileDoesNotExist();
 int exec(char *args[], int arg_size);   //declare exec function to avoid compilation errors
+int stats(char *args[], int args_size);
+int admission(char *args[], int args_size);
+int paging(char *args[], int args_size);
+int dag(char *args[], int args_size);
+int jobs();
+int wait_job(char *args[], int args_size);
+int kill_job(char *id);
+int group(char *args[], int args_size);
+int checkpoint(char *args[], int args_size);
+int restore(char *path);
+int metrics(char *args[], int args_size);
+int record(char *path);
+int replay(char *path);
+int workers(char *args[], int args_size);
+int quota(char *args[], int args_size);
+int export(char *var);
+int auto_decisions();
+int dispatch(char *command_args[], int args_size);
 PCB *create_batch_script_pcb(int pid, FILE * batchFile);        //declare function that will create PCB for batch script process
 
 // Interpret commands and their arguments
@@ -83,6 +118,21 @@ int interpreter(char *command_args[], int args_size) {
         command_args[i][strcspn(command_args[i], "\r\n")] = 0;
     }
 
+    // time every command into its histogram, see the stats command
+    int command = stats_command_id(command_args[0]);
+    uint64_t start = stats_now();
+    int errorCode = dispatch(command_args, args_size);
+    stats_record(&stats_commands[command], stats_now() - start);
+    metrics_counters[METRIC_COMMANDS]++;
+    metrics_counters[METRIC_COMMAND_ERRORS] += errorCode != 0;
+    if (metrics_interval_ns) {
+        metrics_tick();
+    }
+    return errorCode;
+}
+
+// Run the builtin named by command_args[0]
+int dispatch(char *command_args[], int args_size) {
     if (strcmp(command_args[0], "help") == 0) {
         //help
         if (args_size != 1)
@@ -147,6 +197,91 @@ int interpreter(char *command_args[], int args_size) {
         }
         return exec(&command_args[1], args_size - 1);
 
+    } else if (strcmp(command_args[0], "stats") == 0) {
+        if (args_size > 2)
+            return badcommand();
+        return stats(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "admission") == 0) {
+        if (args_size > 2)
+            return badcommand();
+        return admission(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "paging") == 0) {
+        if (args_size > 2)
+            return badcommand();
+        return paging(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "dag") == 0) {
+        if (args_size < 3)      //dag + at least 1 script + policy
+            return badcommand();
+        return dag(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "jobs") == 0) {
+        if (args_size != 1)
+            return badcommand();
+        return jobs();
+
+    } else if (strcmp(command_args[0], "wait") == 0) {
+        if (args_size > 2)
+            return badcommand();
+        return wait_job(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "kill") == 0) {
+        if (args_size != 2)
+            return badcommand();
+        return kill_job(command_args[1]);
+
+    } else if (strcmp(command_args[0], "group") == 0) {
+        if (args_size != 1 && args_size != 4)
+            return badcommand();
+        return group(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "checkpoint") == 0) {
+        if (args_size != 2 && args_size != 3)
+            return badcommand();
+        return checkpoint(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "restore") == 0) {
+        if (args_size != 2)
+            return badcommand();
+        return restore(command_args[1]);
+
+    } else if (strcmp(command_args[0], "metrics") == 0) {
+        if (args_size > 3)
+            return badcommand();
+        return metrics(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "record") == 0) {
+        if (args_size != 2)
+            return badcommand();
+        return record(command_args[1]);
+
+    } else if (strcmp(command_args[0], "replay") == 0) {
+        if (args_size != 2)
+            return badcommand();
+        return replay(command_args[1]);
+
+    } else if (strcmp(command_args[0], "workers") == 0) {
+        if (args_size > 3)
+            return badcommand();
+        return workers(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "quota") == 0) {
+        if (args_size > 4)
+            return badcommand();
+        return quota(&command_args[1], args_size - 1);
+
+    } else if (strcmp(command_args[0], "export") == 0) {
+        if (args_size != 2)
+            return badcommand();
+        return export(command_args[1]);
+
+    } else if (strcmp(command_args[0], "auto") == 0) {
+        if (args_size != 1)
+            return badcommand();
+        return auto_decisions();
+
     } else
         return badcommand();
 }
@@ -169,16 +304,33 @@ int quit() {
     exit(0);
 }
 
+//slot of the variable a command names. Script lines had their variable interned when they were loaded,
+//so the scheduler passes the slot in mem_slot_hint and we skip the name lookup.
+int command_slot(char *var, int create) {
+    int slot = mem_slot_hint;
+    mem_slot_hint = -1;         //only the command the line was loaded for may use it
+    if (slot >= 0) {
+        return slot;
+    }
+    return create ? mem_intern(var) : mem_lookup(var);
+}
+
 int set(char *var, char *value) {
-    mem_set_value(var, value);
+    int slot = command_slot(var, 1);
+    if (slot >= 0) {            //if memory is full the value is dropped
+        mem_set_slot(slot, value);
+    }
+    if (scheduler_current) {
+        scheduler_current->usage.variables_written++;
+    }
     return 0;
 }
 
 int print(char *var) {
-    char *value = mem_get_value(var);
+    int slot = command_slot(var, 0);
+    const char *value = slot >= 0 ? mem_get_slot(slot) : NULL;
     if (value) {
         printf("%s\n", value);
-        free(value);
     } else {
         printf("Variable does not exist\n");
     }
@@ -186,109 +338,27 @@ int print(char *var) {
 }
 
 int echo(char *tok) {
-    int must_free = 0;
+    const char *out = tok;
     // is it a var?
     if (tok[0] == '$') {
         tok++;                  // advance pointer, so that tok is now the stuff after '$'
-        tok = mem_get_value(tok);
-        if (tok == NULL) {
-            tok = "";           // must use empty string, can't pass NULL to printf
-        } else {
-            must_free = 1;
+        int slot = command_slot(tok, 0);
+        out = slot >= 0 ? mem_get_slot(slot) : NULL;
+        if (out == NULL) {
+            out = "";           // must use empty string, can't pass NULL to printf
         }
     }
 
-    printf("%s\n", tok);
-
-    // memory management technically optional for this assignment
-    if (must_free)
-        free(tok);
-
+    printf("%s\n", out);
     return 0;
 }
 
-// We can hide dotfiles in ls using either the filter operand to scandir,
-// or by checking the first character ourselves when we go to print
-// the names. That would work, and is less code, but this is more robust.
-// And this is also better since it won't allocate extra dirents.
-int ls_filter(const struct dirent *d) {
-    if (d->d_name[0] == '.')
-        return 0;
-    return 1;
-}
-
-int ls_compare_char(char a, char b) {
-    // assumption: a,b are both either digits or letters.
-    // If this is not true, the characters will be effectively compared
-    // as ASCII when we do the lower_a - lower_b fallback.
-
-    // if both are digits, compare them
-    if (isdigit(a) && isdigit(b)) {
-        return a - b;
-    }
-    // if only a is a digit, then b isn't, so a wins.
-    if (isdigit(a)) {
-        return -1;
-    }
-
-    // lowercase both letters so we can compare their alphabetic position.
-    char lower_a = tolower(a), lower_b = tolower(b);
-    if (lower_a == lower_b) {
-        // a and b are the same letter, possibly in different cases.
-        // If they are really the same letter, this returns 0.
-        // Otherwise, it's negative if A was capital,
-        // and positive if B is capital.
-        return a - b;
-    }
-
-    // Otherwise, compare their alphabetic position by comparing
-    // them at a known case.
-    return lower_a - lower_b;
-}
-
-int ls_compare_str(const char *a, const char *b) {
-    // a simple strcmp implementation that uses ls_compare_char.
-    // We only check if *a is zero, since if *b is zero earlier,
-    // it would've been unequal to *a at that time and we would return.
-    // If *b is zero at the same point or later than *a, we'll exit the
-    // loop and return the correct value with the last comparison.
-
-    while (*a != '\0') {
-        int d = ls_compare_char(*a, *b);
-        if (d != 0)
-            return d;
-        a++, b++;
-    }
-    return ls_compare_char(*a, *b);
-}
-
-int ls_compare(const struct dirent **a, const struct dirent **b) {
-    return ls_compare_str((*a)->d_name, (*b)->d_name);
-}
-
 int ls() {
-    // straight out of the man page examples for scandir
-    // alphasort uses strcoll instead of strcmp,
-    // so we have to implement our own comparator to match the ls spec.
-    // Note that the test cases weren't very picky about the specified order,
-    // so if you just used alphasort with scandir, you should have passed.
-    // This was intentional on our part.
-    struct dirent **namelist;
-    int n;
-
-    n = scandir(".", &namelist, NULL, ls_compare);
-    if (n == -1) {
+    // the listing itself, and the order it's in, lives in listing.c
+    if (list_directory(".") != 0) {
         // something is catastrophically wrong, just give up.
         perror("my_ls couldn't scan the directory");
-        return 0;
     }
-
-    for (size_t i = 0; i < n; ++i) {
-        printf("%s\n", namelist[i]->d_name);
-        free(namelist[i]);
-    }
-    free(namelist);
-
     return 0;
 }
 
@@ -301,24 +371,17 @@ int str_isalphanum(char *name) {
 }
 
 int my_mkdir(char *name) {
-    int must_free = 0;
-
     debug("my_mkdir: ->%s<-\n", name);
 
     if (name[0] == '$') {
         ++name;
-        // lookup name
-        name = mem_get_value(name);
+        // lookup name, the value is borrowed so there is nothing to free
+        int slot = command_slot(name, 0);
+        name = slot >= 0 ? (char *) mem_get_slot(slot) : NULL;
         debug("  lookup: %s\n", name ? name : "(NULL)");
-        if (name) {
-            // name exists, should free whatever we got
-            must_free = 1;
-        }
     }
     if (!name || !str_isalphanum(name)) {
         // either name doesn't exist, or isn't valid, error.
-        if (must_free)
-            free(name);
         return badcommandMkdir();
     }
     // at this point name is definitely OK
@@ -334,8 +397,6 @@ int my_mkdir(char *name) {
         perror("Something went wrong in my_mkdir");
     }
 
-    if (must_free)
-        free(name);
     return 0;
 }
 
@@ -370,48 +431,28 @@ int cd(char *path) {
 }
 
 int source(char *script) {
-    FILE *p = fopen(script, "rt");      // the program is in a file
-
-    if (p == NULL) {
+    BackingStore *backing = backing_open(script);       //index the script, its pages are loaded as it runs
+    if (!backing) {             //the program is in a file, which doesn't exist
         return badcommandFileDoesNotExist();
     }
 
-    char lines[MAX_PROGRAM_SIZE][MAX_PROGRAM_LINE_LENGTH];      //temp buffer for reading lines
-    int line_count = 0;         //initialize line_count for one program
-
-    while (fgets(lines[line_count], MAX_PROGRAM_LINE_LENGTH, p) != NULL) {      //read through all lines of script
-        lines[line_count][strcspn(lines[line_count], "\r\n")] = '\0';   //on the line read from fgets
-        //find the index of the first return or newline char
-        //and replace it with null terminator char
-        line_count++;           //increment for correct indexing
-
-        if (line_count >= MAX_PROGRAM_SIZE) {   //if shared memory limit is reached
-            break;              //stop
-        }
-    }
-    fclose(p);
-
-    int start_index = allocate_program_lines(line_count);       //call function to allocate space in shell memory
-    if (start_index < 0) {      //if allocation fails, print error msg
-        printf("error: not enough memory for script\n");
-        return 1;
-    }
+    PCB *pcb = create_pcb(allocate_pid(), backing, backing->line_count);        //create a new pcb with the right inputs
+    load_initial_pages(pcb);    //source runs right away, it doesn't wait for admission
 
-    for (int i = 0; i < line_count; i++) {      //copy script into shared shell memory
-        //copy line i of temporary buffer, lines, to index [start_index + i] of shared shell memory 
-        strcpy(shell_program_memory.lines[start_index + i], lines[i]);
+    if (global_queue) {         //a script line: the script joins the running queue and this line waits for it
+        adopt_child(pcb);
+        enqueue_arrival(global_queue, pcb, scheduler_policy());
+        block_on_children();
+        return 0;
     }
 
-    static int next_pid = 1;    //for unique PIDS
-    PCB *pcb = create_pcb(next_pid++, start_index, line_count); //create a new pcb with the right inputs
-
     //if global queue doesn't exist yet
     if (!global_queue) {
         global_queue = create_queue();  //create new empty queue
     }
     enqueue(global_queue, pcb); //add newly made pcb to queue
 
-    FCFS(global_queue);         //execute all processes in queue through FCFS
+    run_foreground(global_queue, POLICY_FCFS);  //execute all processes in queue through FCFS
     destroy_queue(global_queue);        //free queue struct
     global_queue = NULL;
 
@@ -420,43 +461,46 @@ int source(char *script) {
 
 int run(char *args[], int arg_size) {
     // copy the args into a new NULL-terminated array.
-    char **adj_args = calloc(arg_size + 1, sizeof(char *));
+    char *adj_args[arg_size + 1];
     for (int i = 0; i < arg_size; ++i) {
         adj_args[i] = args[i];
     }
+    adj_args[arg_size] = NULL;
 
-    // always flush output streams before forking.
+    // always flush output streams before starting a program, it writes to the same stdout.
     fflush(stdout);
-    // attempt to fork the shell
-    pid_t pid = fork();
-    if (pid < 0) {
-        // fork failed. Report the error and move on.
-        perror("fork() failed");
-        return 1;
-    } else if (pid == 0) {
-        // we are the new child process.
-        execvp(adj_args[0], adj_args);
+    // posix_spawn instead of fork, so the shell's memory isn't copied, see spawn.h.
+    // The child never runs any of our code, so unlike after a fork there is no
+    // shared stdin buffer it could give back to the file on its way out.
+    uint64_t start = stats_now();
+    pid_t pid;
+    int error = spawn_program(adj_args, &pid);
+    stats_record(&stats_commands[STAT_RUN_FORK], stats_now() - start);
+    if (error != 0) {
+        // the program couldn't be started. Report the error like the child used to and move on.
+        errno = error;
         perror("exec failed");
-        // The parent and child are sharing stdin, and according to
-        // a part of the glibc documentation that you are **not**
-        // expected to know for this course, a shared input handle
-        // should be fflushed (if it is needed) or closed
-        // (if it is not). Handling this exec error case is not even
-        // necessary, but let's do it right.
-        // (Failure to do this can result in the parent process
-        // reading the remaining input twice in batch mode.)
-        fclose(stdin);
-        exit(1);
-    } else {
-        // we are the parent process.
-        waitpid(pid, NULL, 0);
+        metrics_counters[METRIC_RUN_FAILURES]++;
+        return 0;
     }
+    metrics_counters[METRIC_RUN_FORKS]++;
+    start = stats_now();
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);     //waitpid that also says how much CPU the program used
+    stats_record(&stats_commands[STAT_RUN_WAIT], stats_now() - start);
+    if (scheduler_current) {    //charged to the script that ran it, see quotas.h
+        scheduler_current->usage.runs++;
+        scheduler_current->usage.run_cpu_ns += (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+    }
+    metrics_counters[METRIC_RUN_FAILURES] += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
 
     return 0;
 }
 
 //order of exec function
-//1. check if background mode is enabled
+//1. check if background mode is enabled, or if exec should return right away (&)
 //2. check for valid policy
 //3. check each exec arguement is the name of a DIFFERENT script filename
 //4. check the file does exist
@@ -465,19 +509,38 @@ int run(char *args[], int arg_size) {
 //7. running the correct scheduling policy
 //8. clean up of queue, clean up of pcbs and code in shell memory is handled in other functions
 int exec(char *args[], int arg_size) {
+    int asynchronous = 0;       //set flag for & to false (0) for now
+    if (strcmp(args[arg_size - 1], "&") == 0) { //check if & option is wanted
+        asynchronous = 1;       //in a script line: the line doesn't wait for the programs
+        arg_size--;             //decrement arg_size to exclude "&" from more processing
+        if (arg_size < 2) {     //still needs a program and a policy
+            return badcommand();
+        }
+    }
+
     int background = 0;         //set background flag to false (0) for now
-    if (strcmp(args[arg_size - 1], "#") == 0) { //check if # option is wanted
+    if (strcmp(args[arg_size - 1], "#") == 0 && !asynchronous) {        //check if # option is wanted
         background = 1;         //if yes, set flag to true (1)
         arg_size--;             //decrement arg_size to exclude "#" from more processing
     }
 
 
-    char *policy = args[arg_size - 1];  //array starts at 0, so correctly index to policy by arg_size - 1
+    int tickets;                //share of each program under STRIDE and LOTTERY, or its deadline under EDF
+    int policy = policy_from_spec(args[arg_size - 1], &tickets);        //array starts at 0, so correctly index to policy by arg_size - 1
+    Group *target = policy < 0 ? group_find(args[arg_size - 1]) : NULL; //or the name of a scheduling group
+    if (target) {
+        if (background) {       //the group runs the programs, there is no foreground queue to put the batch script in
+            return badcommand();
+        }
+        if (global_queue) {     //waiting for a group would run it inside this script's queue
+            printf("Bad command: exec into a group only works at the prompt\n");
+            return 1;
+        }
+        policy = target->policy;
+        tickets = policy == POLICY_EDF ? 0 : DEFAULT_TICKETS;   //a group name gives no tickets or deadline
+    }
     //check for a valid policy out of 5 values
-    if (!
-        (strcmp(policy, "FCFS") == 0 || strcmp(policy, "SJF") == 0
-         || strcmp(policy, "RR") == 0 || strcmp(policy, "AGING") == 0
-         || strcmp(policy, "RR30") == 0)) {
+    if (policy < 0) {
         printf("Bad command: wrong scheduling policy, error!\n");       //outputs error msg
         return 1;               //exec terminates
     }
@@ -495,51 +558,68 @@ int exec(char *args[], int arg_size) {
     }
 
     //temp storage
-    int start_indexes[number_of_programs];      //store where each program's 1st line is in shell memory
-    int line_counts[number_of_programs];        //stores how many lines each program has
-    char lines[MAX_PROGRAM_SIZE][MAX_PROGRAM_LINE_LENGTH];      //temp buffer for each program from its file
-    int line_count_total = 0;   //counts total lines loaded
+    BackingStore *programs[number_of_programs]; //each program's file, indexed into pages
 
-    //for loop to load all programs into memory
+    //open all programs first, so a missing file leaves nothing behind in shell memory
     for (int i = 0; i < number_of_programs; i++) {      //from first program to last program
-        FILE *p = fopen(args[i], "rt"); //opens the file
-        if (p == NULL) {        //if file can't be opened
-            for (int j = 0; j < i; j++) {       //free up all program loaded in before current file
-                free_program_lines(start_indexes[j], line_counts[j]);
+        programs[i] = backing_open(args[i]);
+        if (!programs[i]) {     //if file can't be opened
+            for (int j = 0; j < i; j++) {       //close all programs opened before current file
+                backing_close(programs[j]);
             }
             return badcommandFileDoesNotExist();        //return immedietaly after
         }
+    }
+
+    //with workers a foreground exec at the prompt or in a batch file runs in worker processes, see workers.h
+    if (worker_count > 0 && !global_queue && !asynchronous && !target && !background && !jobs_unfinished()
+        && workers_run(programs, number_of_programs, policy) == 0) {
+        return 0;
+    }
 
-        int line_count = 0;
-        while (fgets(lines[line_count], MAX_PROGRAM_LINE_LENGTH, p) != NULL) {  //read through all lines of script
-            lines[line_count][strcspn(lines[line_count], "\r\n")] = '\0';       //on the line read from fgets
-            //find the index of the first return or newline char
-            //and replace it with null terminator char
-            line_count++;       //increment for correct indexing
+    //programs that can't get frames right now wait for running ones to finish,
+    //unless so much is already waiting that the caller should back off
+    if (!admission_has_room(number_of_programs)) {
+        printf("error: admission queue full, try again later\n");
+        for (int i = 0; i < number_of_programs; i++) {
+            backing_close(programs[i]);
+        }
+        return 1;
+    }
 
-            if (line_count >= MAX_PROGRAM_SIZE) {       //if shared memory limit is reached
-                break;          //stop
+    if (global_queue) {         //a script line: the programs join the running queue, see adopt_child
+        for (int i = 0; i < number_of_programs; i++) {
+            PCB *pcb = create_pcb(allocate_pid(), programs[i], programs[i]->line_count);
+            apply_spec(pcb, policy, tickets);
+            adopt_child(pcb);
+            if (admission_submit(pcb, global_queue, scheduler_policy())) {
+                enqueue_arrival(global_queue, pcb, scheduler_policy());
             }
+            //otherwise admission_run enqueues it once enough frames are free
+        }
+        if (!asynchronous) {
+            block_on_children();
         }
-        fclose(p);
+        return 0;
+    }
 
-        int start_index = allocate_program_lines(line_count);   //call function to allocate space in shell memory
-        if (start_index < 0) {  //if allocation fails, print error msg
-            printf("error: not enough memory for script\n");
-            for (int j = 0; j < i; j++) {       //free up all program loaded in before current file
-                free_program_lines(start_indexes[j], line_counts[j]);
+    if (asynchronous || target) {       //hand the programs to the background queue and return
+        Scope *scope = asynchronous ? scope_snapshot() : NULL;   //a job running alongside the shell gets its own variables
+        int id = jobs_submit(programs, number_of_programs, policy, tickets, target, scope);
+        if (id < 0) {
+            scope_release(scope);
+            printf("error: too many jobs, wait for some to finish\n");
+            for (int i = 0; i < number_of_programs; i++) {
+                backing_close(programs[i]);
             }
             return 1;
         }
-
-        for (int j = 0; j < line_count; j++) {  //copy script into shared shell memory
-            //copy line j of temporary buffer, lines, to index [start_index + j] of shared shell memory 
-            strcpy(shell_program_memory.lines[start_index + j], lines[j]);
+        if (!asynchronous) {    //a group runs it alongside the other groups' jobs, until it is done
+            jobs_wait(id);
+            return 0;
         }
-
-        start_indexes[i] = start_index; //store where each program's first line is in shell memory in correct index 
-        line_counts[i] = line_count;    //store each program's line count in correct index
-        line_count_total += line_count; //update total number of lines
+        printf("[%d]\n", id);
+        return 0;
     }
 
     //if global queue doesn't exist yet
@@ -549,23 +629,29 @@ int exec(char *args[], int arg_size) {
 
     //in source code, if(!global_queue) was after the creation of pcb
     //it must be switched now, or else pointers to pcb will be lost
-    static int next_pid = 1;    //for unique PIDS
-
-    if (background) {           //background mode # is on
-        PCB *batch_script_pcb = create_batch_script_pcb(next_pid++, stdin);
-        if (batch_script_pcb == NULL) { //if batch script pcb wasn't properly created
-            for (int i = 0; i < number_of_programs; i++) {      //free up all program loaded in
-                free_program_lines(start_indexes[i], line_counts[i]);
-            }
-        } else if (batch_script_pcb != NULL) {  //if successfully created batch script pcb for remaining lines of batch script process
+    //at a terminal there is no batch script to read ahead, lines typed while the programs run
+    //preempt them at the next instruction instead, see run_foreground
+    if (background && !isatty(STDIN_FILENO)) {  //background mode # is on
+        FILE *rest = input_rest();      //batch input is read ahead in big blocks, see input.h
+        PCB *batch_script_pcb = rest ? create_batch_script_pcb(allocate_pid(), rest) : NULL;
+        if (rest) {
+            fclose(rest);
+        }
+        if (batch_script_pcb != NULL) { //if successfully created batch script pcb for remaining lines of batch script process
             enqueueFront(global_queue, batch_script_pcb);       //new special enqueue, that will put batch pcb at the front, to ensure it'll run first
         }
+        //otherwise there was nothing left in the batch script, the programs still run
     }
 
     for (int i = 0; i < number_of_programs; i++) {      //create a pcb for each program and enqueue it into queue
-        PCB *pcb = create_pcb(next_pid++, start_indexes[i], line_counts[i]);    //create a new pcb with the right inputs
-        enqueue(global_queue, pcb);     //add newly made pcb to queue
+        PCB *pcb = create_pcb(allocate_pid(), programs[i], programs[i]->line_count);    //create a new pcb with the right inputs
+        apply_spec(pcb, policy, tickets);
+        if (admission_submit(pcb, global_queue, policy)) {    //its first pages went straight into shell memory
+            enqueue(global_queue, pcb); //add newly made pcb to queue
+        }
+        //otherwise it is enqueued as soon as finishing programs give back enough frames, run_foreground waits for it
     }
+    admission_run();            //anything still waiting from before that fits now
 
     //we have to ensure that batch script process runs FIRST
     //for FCFS, RR, RR30 the order of queue is not changed upon calling their respective functions
@@ -573,17 +659,7 @@ int exec(char *args[], int arg_size) {
     //to adjust for this, we will save the batch script process PCB that is currently the head of the queue
     //reorder according to job length score, and then reattach batch script process PCB to the head of queue
     //to ensure batch script process will run first regardless of scheduling policy
-    if (strcmp(policy, "FCFS") == 0) {
-        FCFS(global_queue);     //execute all processes in queue through FCFS
-    } else if (strcmp(policy, "SJF") == 0) {
-        SJF(global_queue);      //execute all processes in queue through SJF
-    } else if (strcmp(policy, "RR") == 0) {
-        RR(global_queue, 2);    //execute all processes in queue through round robin    
-    } else if (strcmp(policy, "RR30") == 0) {
-        RR(global_queue, 30);   //execute all processes in queue through round robin, time slice = 30
-    } else if (strcmp(policy, "AGING") == 0) {
-        AGING(global_queue);    //execute all processes in queue with SJF with job Aging
-    }
+    run_foreground(global_queue, policy);       //execute all processes in queue with the chosen policy, typed lines still get in
 
     destroy_queue(global_queue);        //free queue struct
     global_queue = NULL;
@@ -591,38 +667,338 @@ int exec(char *args[], int arg_size) {
     return 0;
 }
 
-//helper function to create pcb for batch script process
-PCB *create_batch_script_pcb(int pid, FILE *batchFile) {
-    char lines[MAX_PROGRAM_SIZE][MAX_PROGRAM_LINE_LENGTH];      //temp buffer for reading lines
-    int line_count = 0;         //initialize line_count for one program
+//stats prints the latency histograms, stats reset clears them
+int stats(char *args[], int args_size) {
+    if (args_size == 0) {
+        stats_print();
+        return 0;
+    }
+    if (strcmp(args[0], "reset") == 0) {
+        stats_reset();
+        return 0;
+    }
+    return badcommand();
+}
 
-    while (fgets(lines[line_count], MAX_PROGRAM_LINE_LENGTH, batchFile) != NULL) {      //read through all lines of batch script
-        lines[line_count][strcspn(lines[line_count], "\r\n")] = '\0';   //on the line read from fgets
-        //find the index of the first return or newline char
-        //and replace it with null terminator char
-        line_count++;           //increment for correct indexing
+//admission prints the admission queue counters, admission FIFO|SMALLEST picks the order it admits in
+int admission(char *args[], int args_size) {
+    if (args_size == 0) {
+        admission_print();
+        return 0;
+    }
+    if (strcmp(args[0], "FIFO") == 0) {
+        admission_order = ADMISSION_FIFO;
+    } else if (strcmp(args[0], "SMALLEST") == 0) {
+        admission_order = ADMISSION_SMALLEST;
+    } else {
+        return badcommand();
+    }
+    admission_run();            //a new order may let something in right away
+    return 0;
+}
+
+//paging prints the paging counters, paging LRU|CLOCK picks the page replacement policy
+int paging(char *args[], int args_size) {
+    if (args_size == 0) {
+        paging_print();
+        return 0;
+    }
+    if (strcmp(args[0], "LRU") == 0) {
+        replacement_policy = REPLACE_LRU;
+    } else if (strcmp(args[0], "CLOCK") == 0) {
+        replacement_policy = REPLACE_CLOCK;
+    } else {
+        return badcommand();
+    }
+    return 0;
+}
+
+//dag SCRIPT[:DEP,DEP...]... POLICY, see dag.h
+int dag(char *args[], int args_size) {
+    if (global_queue) {         //its exit hook and queue can't be shared with the running scripts
+        printf("Bad command: dag only works at the prompt\n");
+        return 1;
+    }
+    int tickets;
+    int policy = policy_from_spec(args[args_size - 1], &tickets);
+    if (policy < 0) {
+        printf("Bad command: wrong scheduling policy, error!\n");
+        return 1;
+    }
+    int status = dag_exec(args, args_size - 1, policy, tickets);
+    if (status == DAG_NO_FILE) {
+        return badcommandFileDoesNotExist();
+    } else if (status == DAG_BAD_SPEC) {
+        printf("Bad command: dag dependencies must name earlier scripts, each script once\n");
+    } else if (status == DAG_TOO_BIG) {
+        printf("Bad command: dag takes at most %d scripts\n", DAG_MAX_NODES);
+    } else if (status == DAG_BUSY) {
+        printf("error: admission queue full or dag already running, try again later\n");
+    }
+    return status;
+}
+
+//jobs lists background jobs
+int jobs() {
+    jobs_print();
+    return 0;
+}
+
+//wait runs background jobs until they are all done, wait ID until that one is
+int wait_job(char *args[], int args_size) {
+    if (global_queue) {         //the queue it would run is the one running this script
+        printf("Bad command: wait only works at the prompt\n");
+        return 1;
+    }
+    if (jobs_wait(args_size == 0 ? 0 : atoi(args[0])) != 0) {
+        printf("Bad command: no such job\n");
+        return 1;
+    }
+    return 0;
+}
+
+//kill ID drops a background job
+int kill_job(char *id) {
+    if (global_queue) {         //its processes may be the ones running
+        printf("Bad command: kill only works at the prompt\n");
+        return 1;
+    }
+    if (jobs_kill(atoi(id)) != 0) {
+        printf("Bad command: no such job\n");
+        return 1;
+    }
+    return 0;
+}
 
-        if (line_count >= MAX_PROGRAM_SIZE) {   //if shared memory limit is reached
-            break;              //stop
+//group lists scheduling groups, group NAME WEIGHT POLICY creates or changes one, see groups.h
+int group(char *args[], int args_size) {
+    if (args_size == 0) {
+        groups_print();
+        return 0;
+    }
+    int weight = atoi(args[1]);
+    int policy = policy_from_name(args[2]);     //tickets are per job, not per group
+    if (policy < 0) {
+        printf("Bad command: wrong scheduling policy, error!\n");
+        return 1;
+    }
+    if (weight < 1 || weight > STRIDE1) {
+        printf("Bad command: group weight must be between 1 and %d\n", STRIDE1);
+        return 1;
+    }
+    //exec tells a group from a policy by its name, and POLICY:TICKETS specs by their colon, default is always there
+    if (policy_from_spec(args[0], &(int) { 0 }) >= 0 || strchr(args[0], ':') || strcmp(args[0], "default") == 0
+        || strlen(args[0]) >= GROUP_NAME_LENGTH) {
+        printf("Bad command: %s can't be a group name\n", args[0]);
+        return 1;
+    }
+    if (group_define(args[0], weight, policy) != 0) {
+        printf("error: at most %d groups\n", GROUPS_MAX);
+        return 1;
+    }
+    return 0;
+}
+
+//checkpoint PATH [EVERY] writes a snapshot, and with EVERY keeps rewriting it, see checkpoint.h
+int checkpoint(char *args[], int args_size) {
+    if (global_queue) {         //a script line runs in the middle of an instruction, there is nothing consistent to save
+        printf("Bad command: checkpoint only works at the prompt\n");
+        return 1;
+    }
+    if (args_size == 2) {
+        char *end;
+        long every = strtol(args[1], &end, 10);
+        if (*end != '\0' || every < 0 || every > 1000000000) {
+            return badcommand();
         }
+        checkpoint_schedule(args[0], (int) every);
     }
+    if (checkpoint_blocked(NULL)) {     //periodic ones are still written once it returns
+        printf("error: a nested exec or source is running, checkpoint once it returns\n");
+        return 1;
+    }
+    if (checkpoint_write(args[0], NULL) != 0) {
+        printf("error: can't write checkpoint %s\n", args[0]);
+        return 1;
+    }
+    return 0;
+}
 
-    if (line_count == 0) {      //if there was nothing else after
-        return NULL;            //no need to create batch script process PCB
+//restore PATH resumes a run from a snapshot
+int restore(char *path) {
+    if (global_queue || foreground_queue) {     //its processes would land in the queue that is running
+        printf("Bad command: restore only works at the prompt\n");
+        return 1;
+    }
+    int policy;
+    int status = checkpoint_restore(path, &policy);
+    if (status == CHECKPOINT_NO_FILE) {
+        return badcommandFileDoesNotExist();
+    } else if (status == CHECKPOINT_CORRUPT) {
+        printf("error: %s is not a checkpoint\n", path);
+        return 1;
+    } else if (status == CHECKPOINT_BUSY) {
+        printf("error: admission queue full, try again later\n");
+        return 1;
+    }
+
+    run_foreground(global_queue, policy);       //carry on where the snapshot stopped
+    destroy_queue(global_queue);
+    global_queue = NULL;
+    return 0;
+}
+
+//metrics prints the metrics, metrics PATH [SECONDS] writes them to a file for scraping, see metrics.h
+int metrics(char *args[], int args_size) {
+    if (args_size == 0) {
+        metrics_print(stdout);
+        return 0;
     }
+    if (args_size == 2) {
+        char *end;
+        long seconds = strtol(args[1], &end, 10);
+        if (*end != '\0' || seconds < 0 || seconds > 86400) {
+            return badcommand();
+        }
+        metrics_schedule(args[0], (int) seconds);
+    }
+    if (metrics_write(args[0]) != 0) {
+        printf("error: can't write metrics to %s\n", args[0]);
+        return 1;
+    }
+    return 0;
+}
 
-    int start_index = allocate_program_lines(line_count);       //call function to allocate space in shell memory
-    if (start_index < 0) {      //if allocation fails, print error msg
-        printf("error: not enough memory for script\n");
-        return NULL;            //return NULL, don't create PCB for batch script process
+//record PATH logs the scheduling decisions of every foreground run to PATH, record off stops, see decisions.h
+int record(char *path) {
+    if (strcmp(path, "off") == 0) {
+        decisions_record(NULL);
+        return 0;
+    }
+    if (decisions_record(path) != 0) {
+        printf("error: can't write decision log %s\n", path);
+        return 1;
     }
+    return 0;
+}
 
-    for (int i = 0; i < line_count; i++) {      //copy script into shared shell memory
-        //copy line j of temporary buffer, lines, to index [start_index + i] of shared shell memory 
-        strcpy(shell_program_memory.lines[start_index + i], lines[i]);
+//replay PATH runs the logged runs again and reports where their decisions differ
+int replay(char *path) {
+    if (global_queue || foreground_queue) {     //its processes would land in the queue that is running
+        printf("Bad command: replay only works at the prompt\n");
+        return 1;
+    }
+    int status = replay_open(path);
+    if (status == REPLAY_NO_FILE) {
+        return badcommandFileDoesNotExist();
+    } else if (status == REPLAY_CORRUPT) {
+        printf("error: %s is not a decision log\n", path);
+        return 1;
+    }
+
+    int policy;
+    while ((status = replay_next_run(&policy)) > 0) {
+        run_foreground(global_queue, policy);
+        destroy_queue(global_queue);
+        global_queue = NULL;
+        replay_end_run();
+    }
+    replay_close();
+    if (status < 0) {
+        printf("error: %s is damaged, or its processes don't fit in the admission queue\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+//workers prints how many worker processes execs run on, workers N changes it, 0 runs them in the shell,
+//workers pin on|off pins them to CPUs
+int workers(char *args[], int args_size) {
+    if (args_size == 0) {
+        printf("%d%s\n", worker_count, worker_pinning ? " pinned" : "");
+        return 0;
+    }
+    if (strcmp(args[0], "pin") == 0) {
+        if (args_size != 2 || (strcmp(args[1], "on") != 0 && strcmp(args[1], "off") != 0)) {
+            return badcommand();
+        }
+        worker_pinning = strcmp(args[1], "on") == 0;
+        return 0;
+    }
+    char *end;
+    long count = strtol(args[0], &end, 10);
+    if (*end != '\0' || end == args[0] || count < 0 || count > WORKERS_MAX) {
+        return badcommand();
+    }
+    worker_count = (int) count;
+    return 0;
+}
+
+//export VAR copies a background job's value of VAR to the global variables, see scopes.h.
+//Anywhere else every variable is global already.
+int export(char *var) {
+    if (!mem_scope) {
+        return 0;
+    }
+    int slot = command_slot(var, 0);
+    const char *value = slot >= 0 ? mem_get_slot(slot) : NULL;
+    if (!value) {
+        printf("Variable does not exist\n");
+        return 0;
+    }
+    Scope *scope = mem_scope;
+    mem_scope = NULL;
+    mem_set_slot(slot, value);  //value is the job's, setting the global one leaves it alone
+    mem_scope = scope;
+    return 0;
+}
+
+//auto prints what the AUTO policy measured and chose lately, see scheduler.h
+int auto_decisions() {
+    auto_print();
+    return 0;
+}
+
+//quota prints the limits, quota RESOURCE LIMIT [kill|lower] sets one, quota RESOURCE off drops it,
+//quota report on|off prints each process's usage when it finishes, see quotas.h
+int quota(char *args[], int args_size) {
+    if (args_size == 0) {
+        quota_print();
+        return 0;
+    }
+    if (args_size == 2 && strcmp(args[0], "report") == 0
+        && (strcmp(args[1], "on") == 0 || strcmp(args[1], "off") == 0)) {
+        quota_reports(strcmp(args[1], "on") == 0);
+        return 0;
+    }
+    int resource = quota_from_name(args[0]);
+    if (resource < 0 || args_size < 2) {
+        return badcommand();
+    }
+    if (args_size == 2 && strcmp(args[1], "off") == 0) {
+        quota_set(resource, 0, QUOTA_KILL);
+        return 0;
+    }
+    char *end;
+    long long limit = strtoll(args[1], &end, 10);
+    int action = args_size == 3 && strcmp(args[2], "lower") == 0 ? QUOTA_LOWER : QUOTA_KILL;
+    if (*end != '\0' || end == args[1] || limit <= 0
+        || (args_size == 3 && action == QUOTA_KILL && strcmp(args[2], "kill") != 0)) {
+        return badcommand();
+    }
+    quota_set(resource, (uint64_t) limit, action);
+    return 0;
+}
+
+//helper function to create pcb for batch script process
+PCB *create_batch_script_pcb(int pid, FILE *batchFile) {
+    BackingStore *backing = backing_from_stream(batchFile);     //the rest of the batch script is paged in like any other script
+    if (!backing) {             //if there was nothing else after
+        return NULL;            //no need to create batch script process PCB
     }
 
-    PCB *pcb = create_pcb(pid, start_index, line_count);        //create a PCB
+    PCB *pcb = create_pcb(pid, backing, backing->line_count);   //create a PCB
+    load_initial_pages(pcb);    //it runs first, so it doesn't wait for admission
     pcb->is_batch_script = 1;   //set priority flag to true (1)
 
     return pcb;
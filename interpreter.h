@@ -1,2 +1,4 @@
+#include "shellmemory.h"
+
 int interpreter(char *command_args[], int args_size);
 int help();
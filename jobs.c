@@ -0,0 +1,430 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include "jobs.h"
+#include "admission.h"
+#include "checkpoint.h"
+#include "decisions.h"
+#include "groups.h"
+#include "scheduler.h"
+#include "scopes.h"
+#include "shell.h"
+#include "stats.h"
+
+#define JOBS_MAX_PROGRAMS 3     //exec takes up to 3 scripts
+
+enum { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_KILLED };
+static const char *state_names[] = { "QUEUED", "RUNNING", "DONE", "KILLED" };
+
+typedef struct Job {
+    int id;
+    int state;                  //JOB_*
+    int policy;
+    int tickets;                //STRIDE and LOTTERY share of each of its processes, or their EDF deadline
+    Group *group;               //group it runs in
+    BackingStore *programs[JOBS_MAX_PROGRAMS];  //held until the job starts
+    Scope *scope;               //variables its processes use, NULL for the global ones
+    int program_count;
+    int processes_left;         //processes that haven't finished yet
+    int lines_total;
+    int lines_done;             //instructions of processes that finished
+} Job;
+
+static Job jobs[JOBS_MAX];      //in submission order
+static int job_count = 0;
+static int next_id = 1;
+
+ReadyQueue *foreground_queue = NULL;
+int foreground_policy;
+
+static int hooked = 0;          //jobs_exit is installed
+static void (*outer_exit_hook)(PCB * pcb) = NULL;       //whoever had scheduler_exit_hook before the first job
+static int waiting_for = 0;     //job wait is running the queue for, 0 if none
+static int wait_done = 0;       //that job finished
+
+//the group running right now
+static int ran;                 //instructions it ran this turn
+static int quantum;             //instructions its turn lasts, 0 if no other group is waiting
+static int quantum_expired;
+static int watch_input;         //yield as soon as a line is typed
+static ReadyQueue *admitting = NULL;    //foreground queue whose programs wait for frames, yield once one got in
+static int input_arrived;
+
+static Job *find_job(int id) {
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i].id == id) {
+            return &jobs[i];
+        }
+    }
+    return NULL;
+}
+
+static int is_finished(Job *job) {
+    return job->state == JOB_DONE || job->state == JOB_KILLED;
+}
+
+//a process finished, count it against its job
+static void jobs_exit(PCB *pcb) {
+    if (outer_exit_hook) {
+        outer_exit_hook(pcb);
+    }
+    Job *job = pcb->job_id && !pcb->parent ? find_job(pcb->job_id) : NULL;
+    if (!job) {
+        return;                 //a foreground process, or one a job's script started, its parent counts for it
+    }
+    job->lines_done += pcb->number_of_lines;
+    if (--job->processes_left == 0) {
+        job->state = JOB_DONE;
+        if (job->id == waiting_for) {
+            wait_done = 1;
+            scheduler_yield = 1;        //wait has what it came for
+        }
+    }
+}
+
+static int input_ready() {
+    struct pollfd input = {.fd = STDIN_FILENO,.events = POLLIN };
+    return poll(&input, 1, 0) > 0;
+}
+
+//before every foreground instruction at a terminal: stop the running policy at the next
+//instruction boundary as soon as a line is typed, and take periodic checkpoints
+//a poll with no timeout is one cheap syscall, so it is done before every instruction
+static void foreground_tick(PCB *pcb) {
+    checkpoint_tick(pcb);
+    if (input_ready()) {
+        scheduler_yield = 1;
+    }
+}
+
+//count instructions against the running group's turn, and watch for typed lines
+static void group_tick(PCB *pcb) {
+    (void) pcb;
+    if (watch_input && input_ready()) {
+        input_arrived = 1;
+        scheduler_yield = 1;
+    }
+    if (admitting && !is_empty(admitting)) {
+        scheduler_yield = 1;
+    }
+    if (++ran == quantum) {     //never for a quantum of 0
+        quantum_expired = 1;
+        scheduler_yield = 1;
+    }
+}
+
+//hand a job's programs to its group's queue
+static void start_job(Job *job) {
+    Group *group = job->group;
+    job->state = JOB_RUNNING;
+    if (group == group_default()) {
+        group->policy = job->policy;    //the default group runs whatever its jobs asked for
+    }
+    for (int i = 0; i < job->program_count; i++) {
+        PCB *pcb = create_pcb(allocate_pid(), job->programs[i], job->programs[i]->line_count);
+        pcb->job_id = job->id;
+        pcb->scope = job->scope;
+        if (pcb->scope) {
+            scope_hold(pcb->scope);
+        }
+        apply_spec(pcb, job->policy, job->tickets);
+        job->programs[i] = NULL;
+        if (admission_submit(pcb, group->queue, group->policy)) {
+            enqueue_arrival(group->queue, pcb, group->policy);
+        }
+        //otherwise admission_run enqueues it once enough frames are free
+    }
+}
+
+//whether a job in the default group is running
+static int default_running() {
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i].state == JOB_RUNNING && jobs[i].group == group_default()) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//default group is idle, start everything queued with the policy of the oldest queued job
+//jobs in named groups never queue, their group's policy is fixed
+static int start_queued_jobs() {
+    int policy = -1;
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i].state != JOB_QUEUED) {
+            continue;
+        }
+        if (policy == -1) {
+            policy = jobs[i].policy;
+        }
+        if (jobs[i].policy == policy) {
+            start_job(&jobs[i]);
+        }
+    }
+    return policy != -1;
+}
+
+//run background groups until they are out of work or something asks them to yield, returns 1 if it yielded
+//each turn goes to the group with the lowest pass, see groups.h
+static int run_background(int interruptible) {
+    if (!hooked) {
+        return 0;               //no job was ever submitted
+    }
+    while (1) {
+        if (!default_running()) {
+            start_queued_jobs();
+        }
+        Group *group = group_next();
+        if (!group) {
+            return 0;
+        }
+        ran = 0;
+        quantum = groups_with_work() > 1 ? group_quantum : 0;
+        quantum_expired = input_arrived = 0;
+        watch_input = interruptible;
+
+        void (*outer_tick)(PCB * pcb) = scheduler_tick_hook;
+        scheduler_tick_hook = group_tick;
+        global_queue = group->queue;    //admission and nested commands see the running queue
+        run_policy(group->queue, group->policy);
+        scheduler_tick_hook = outer_tick;
+        global_queue = NULL;
+        group_charge(group, ran);
+
+        if (scheduler_yield) {
+            scheduler_yield = 0;
+            if (input_arrived || wait_done || !quantum_expired) {
+                return 1;
+            }
+            //the turn is over, the next group goes
+        }
+    }
+}
+
+//drop finished jobs once they have been reported
+static void forget_finished() {
+    int kept = 0;
+    for (int i = 0; i < job_count; i++) {
+        if (!is_finished(&jobs[i])) {
+            jobs[kept++] = jobs[i];
+        } else {
+            scope_release(jobs[i].scope);       //its processes let go of theirs as they finished
+        }
+    }
+    job_count = kept;
+}
+
+int jobs_submit(BackingStore *programs[], int program_count, int policy, int tickets, Group *group, Scope *scope) {
+    if (job_count == JOBS_MAX) {
+        return -1;
+    }
+    if (!hooked) {
+        hooked = 1;
+        outer_exit_hook = scheduler_exit_hook;
+        scheduler_exit_hook = jobs_exit;
+    }
+
+    Job *job = &jobs[job_count++];
+    job->id = next_id++;
+    job->state = JOB_QUEUED;
+    job->group = group ? group : group_default();
+    job->policy = group ? group->policy : policy;
+    job->tickets = tickets;
+    job->scope = scope;
+    job->program_count = program_count;
+    job->processes_left = program_count;
+    job->lines_total = 0;
+    job->lines_done = 0;
+    for (int i = 0; i < program_count; i++) {
+        job->programs[i] = programs[i];
+        job->lines_total += programs[i]->line_count;
+    }
+
+    //in the default group it joins the running jobs if it has their policy, otherwise it waits its turn
+    int running = 0, queued = 0;
+    for (int i = 0; i < job_count - 1; i++) {
+        running |= jobs[i].state == JOB_RUNNING && jobs[i].group == job->group;
+        queued |= jobs[i].state == JOB_QUEUED;
+    }
+    if (group || (running ? policy == job->group->policy : !queued)) {
+        start_job(job);
+    }
+    return job->id;
+}
+
+void jobs_run_until_input() {
+    if (!input_ready()) {       //nothing typed yet
+        run_background(1);
+    }
+}
+
+//queue ran dry but some of its programs still wait in admission for frames background jobs
+//hold: run those jobs until one of the programs gets in. Returns 1 if queue has work again,
+//0 if nothing of it is waiting, or if nothing is left that could give frames back, then the
+//programs are dropped
+static int wait_for_admission(ReadyQueue *queue) {
+    while (is_empty(queue) && admission_pending(queue) > 0) {
+        ReadyQueue *running = global_queue;
+        admitting = queue;
+        int yielded = run_background(0);
+        admitting = NULL;
+        global_queue = running;
+        if (!yielded && is_empty(queue)) {
+            admission_run();
+            if (is_empty(queue)) {
+                printf("error: %d programs never got program memory, they are dropped\n", admission_cancel_queue(queue));
+            }
+        }
+    }
+    return !is_empty(queue);
+}
+
+void run_foreground(ReadyQueue *queue, int policy) {
+    ReadyQueue *outer_queue = foreground_queue; //an exec in a running script runs the same queue again
+    int outer_policy = foreground_policy;
+    foreground_queue = queue;
+    foreground_policy = policy;
+    decisions_run_start(queue, policy);
+    if (!isatty(STDIN_FILENO)) {        //batch input is always ready, it waits its turn like before
+        void (*outer_tick)(PCB * pcb) = scheduler_tick_hook;
+        if (checkpoint_every) {
+            scheduler_tick_hook = checkpoint_tick;
+        }
+        run_policy(queue, policy);
+        while (!scheduler_yield && wait_for_admission(queue)) {
+            run_policy(queue, policy);
+        }
+        scheduler_tick_hook = outer_tick;
+        foreground_queue = outer_queue;
+        foreground_policy = outer_policy;
+        decisions_run_end();
+        return;
+    }
+    while (1) {
+        void (*outer_tick)(PCB * pcb) = scheduler_tick_hook;
+        scheduler_tick_hook = foreground_tick;
+        run_policy(queue, policy);
+        scheduler_tick_hook = outer_tick;
+        if (!scheduler_yield && wait_for_admission(queue)) {
+            continue;           //some of its programs got in at last
+        }
+        if (!scheduler_yield) {
+            foreground_queue = outer_queue;
+            foreground_policy = outer_policy;
+            decisions_run_end();
+            return;             //queue is empty
+        }
+        scheduler_yield = 0;
+
+        //run the typed line as if it came in at the prompt: with no queue running, so an exec
+        //or source it starts gets its own queue instead of draining and freeing this one
+        char line[MAX_USER_INPUT];
+        if (fgets(line, MAX_USER_INPUT - 1, stdin) == NULL) {
+            clearerr(stdin);    //^D ends the shell at the prompt, not in the middle of a run
+            continue;
+        }
+        ReadyQueue *running = global_queue;
+        global_queue = NULL;
+        parseInput(line);
+        global_queue = running;
+    }
+}
+
+int jobs_wait(int id) {
+    Job *job = id ? find_job(id) : NULL;
+    if (id && !job) {
+        return 1;
+    }
+    waiting_for = id;
+    wait_done = 0;
+    while (!(job && is_finished(job)) && run_background(0)) {
+        //run_background only yields early when the job wait is after finishes
+    }
+    waiting_for = 0;
+    forget_finished();
+    return 0;
+}
+
+//pcb's parents are in no queue: waiting in a nested exec or source, or kept for their children
+//after their own program ended. They are killed before their children go, so child_gone frees
+//them instead of waking them up or counting the job done
+static void kill_parents(Job *job, PCB *pcb) {
+    for (PCB * parent = pcb->parent; parent && parent->exited != EXITED_KILLED; parent = parent->parent) {
+        if (!parent->parent) {
+            job->lines_done += parent->pc;
+        }
+        if (parent->exited) {
+            parent->exited = EXITED_KILLED;     //its frames are already gone
+        } else {
+            kill_process(parent);
+        }
+    }
+}
+
+int jobs_kill(int id) {
+    Job *job = find_job(id);
+    if (!job) {
+        return 1;
+    }
+    if (job->state == JOB_QUEUED) {
+        for (int i = 0; i < job->program_count; i++) {
+            backing_close(job->programs[i]);
+        }
+    } else if (job->state == JOB_RUNNING) {
+        ReadyQueue *queue = job->group->queue;
+        for (PCB * pcb = queue->head; pcb; pcb = pcb->next) {
+            if (pcb->job_id == id) {
+                kill_parents(job, pcb);
+            }
+        }
+        PCB *waiting[ADMISSION_MAX_PENDING];
+        int count = admission_waiting(queue, waiting, ADMISSION_MAX_PENDING);
+        for (int i = 0; i < count; i++) {
+            if (waiting[i]->job_id == id) {
+                kill_parents(job, waiting[i]);
+            }
+        }
+        PCB *pcb;
+        while ((pcb = remove_job_pcb(queue, id))) {
+            if (!pcb->parent) { //lines_total only counts the job's own scripts
+                job->lines_done += pcb->pc;
+            }
+            kill_process(pcb);
+        }
+        admission_cancel(id);
+    }
+    if (!is_finished(job)) {
+        job->state = JOB_KILLED;
+    }
+    return 0;
+}
+
+void jobs_print() {
+    for (int i = 0; i < job_count; i++) {
+        Job *job = &jobs[i];
+        int progress = job->lines_done;
+        if (job->state == JOB_RUNNING) {        //add what its live processes have run so far
+            for (PCB * pcb = job->group->queue->head; pcb; pcb = pcb->next) {
+                if (pcb->job_id == job->id && !pcb->parent) {
+                    progress += pcb->pc;
+                }
+            }
+        }
+        if (job->group == group_default()) {
+            printf("[%d] %s %s %d/%d\n", job->id, state_names[job->state], policy_name(job->policy), progress, job->lines_total);
+        } else {
+            printf("[%d] %s %s(%s) %d/%d\n", job->id, state_names[job->state], job->group->name,
+                   policy_name(job->policy), progress, job->lines_total);
+        }
+    }
+    forget_finished();
+}
+
+int jobs_unfinished() {
+    int unfinished = 0;
+    for (int i = 0; i < job_count; i++) {
+        unfinished += !is_finished(&jobs[i]);
+    }
+    return unfinished;
+}
@@ -0,0 +1,35 @@
+#ifndef JOBS_H
+#   define JOBS_H
+
+#   include "groups.h"
+#   include "paging.h"
+#   include "readyqueue.h"
+
+//Background jobs: exec SCRIPT... POLICY & returns a job id straight away and the scripts run
+//in a background ready queue whenever the shell is waiting for input. At a terminal they run
+//until a line is typed, yield at the next instruction so the line runs, and carry on at the
+//next prompt. In batch mode input is always ready, so they only run during wait and at the end of input.
+//  jobs        list jobs with their state and instructions run so far
+//  wait [ID]   run background work until job ID (or every job) is done
+//  kill ID     drop a job's processes and free their program memory
+//Foreground runs (exec, source, dag) go through run_foreground, which gives typed lines the same
+//priority: a line typed while they run is read at the next instruction boundary and run
+//straight away, then scheduling carries on where it stopped.
+//Jobs run in scheduling groups, see groups.h. Jobs submitted with a policy share the default
+//group, which runs one policy at a time: a job with a different policy stays QUEUED until the
+//default group's jobs are done, like jobs in the daemon.
+
+#   define JOBS_MAX 32          //jobs that may exist at once, done ones are forgotten once jobs or wait reported them
+
+extern ReadyQueue *foreground_queue;    //queue run_foreground is running, NULL if none
+extern int foreground_policy;   //and its policy
+
+int jobs_submit(BackingStore * programs[], int program_count, int policy, int tickets, Group * group, struct Scope *scope);      //start or queue a job in group (the default group with policy if NULL), its processes use scope's variables (NULL for the global ones), takes the programs and the reference to scope, returns its id or -1 if there are too many jobs
+void jobs_run_until_input();    //run background work until stdin has input or there is nothing left
+void run_foreground(ReadyQueue * queue, int policy);    //run_policy, but at a terminal a typed line preempts it at the next instruction
+int jobs_wait(int id);          //run background work until job id is done, 0 waits for all, returns 1 if there is no such job
+int jobs_kill(int id);          //returns 1 if there is no such job
+void jobs_print();
+int jobs_unfinished();          //jobs that are queued or running
+
+#endif
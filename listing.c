@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>              // tolower, isdigit
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>        // SYS_getdents64
+#include "listing.h"
+
+#define BATCH_SIZE (1 << 20)    //bytes of directory entries asked for per getdents64
+#define SMALL_BUCKET 32         //names a radix pass leaves to insertion sort
+#define LISTING_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+
+//what getdents64 fills the buffer with, glibc only declares it for its own getdents64
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+//a name in the arena, with its key at the same offset in the key buffer
+typedef struct Name {
+    size_t offset;
+    size_t length;
+} Name;
+
+static unsigned char rank_of[256];      //sort key byte for each character, 0 is past the end of a name
+static const unsigned char *keys;       //key buffer of the listing being sorted
+
+//the last listing, valid until its watch reports a change
+static struct {
+    char *text;
+    size_t length;
+    dev_t device;
+    ino_t inode;
+    int watch;                  //inotify watch on the directory, -1 if there is none
+} cached = {.watch = -1 };
+static int events = -1;         //inotify descriptor, opened on the first listing
+
+int ls_compare_char(char a, char b) {
+    // assumption: a,b are both either digits or letters.
+    // If this is not true, the characters will be effectively compared
+    // as ASCII when we do the lower_a - lower_b fallback.
+
+    // if both are digits, compare them
+    if (isdigit(a) && isdigit(b)) {
+        return a - b;
+    }
+    // if only a is a digit, then b isn't, so a wins.
+    if (isdigit(a)) {
+        return -1;
+    }
+
+    // lowercase both letters so we can compare their alphabetic position.
+    char lower_a = tolower(a), lower_b = tolower(b);
+    if (lower_a == lower_b) {
+        // a and b are the same letter, possibly in different cases.
+        // If they are really the same letter, this returns 0.
+        // Otherwise, it's negative if A was capital,
+        // and positive if B is capital.
+        return a - b;
+    }
+
+    // Otherwise, compare their alphabetic position by comparing
+    // them at a known case.
+    return lower_a - lower_b;
+}
+
+//ls_compare_char isn't an order for every pair: a digit beats whatever comes after it, but
+//something below '0' in ASCII, like '.' or the end of a name, beats a digit that comes after
+//it too. The key order lets the digit win against characters and the end of the name win
+//against everything, so a name comes right before the names it starts.
+static int character_order(const void *x, const void *y) {
+    char a = *(const char *) x, b = *(const char *) y;
+    if (isdigit(b) && !isdigit(a)) {
+        return 1;
+    }
+    return ls_compare_char(a, b);
+}
+
+static void rank_characters() {
+    char characters[255];
+    for (int i = 0; i < 255; i++) {
+        characters[i] = i + 1;
+    }
+    qsort(characters, 255, 1, character_order);
+    for (int i = 0; i < 255; i++) {
+        rank_of[(unsigned char) characters[i]] = i + 1;
+    }
+}
+
+static int key_at(const Name *name, size_t depth) {
+    return depth < name->length ? keys[name->offset + depth] : 0;
+}
+
+//keys are compared like strings, the first depth bytes are already known to be equal
+static int compare_from(const Name *a, const Name *b, size_t depth) {
+    size_t common = a->length < b->length ? a->length : b->length;
+    if (depth < common) {
+        int d = memcmp(keys + a->offset + depth, keys + b->offset + depth, common - depth);
+        if (d != 0) {
+            return d;
+        }
+    }
+    return (a->length > b->length) - (a->length < b->length);
+}
+
+static void insertion_sort(Name *names, size_t count, size_t depth) {
+    for (size_t i = 1; i < count; i++) {
+        Name name = names[i];
+        size_t j = i;
+        for (; j > 0 && compare_from(&names[j - 1], &name, depth) > 0; j--) {
+            names[j] = names[j - 1];
+        }
+        names[j] = name;
+    }
+}
+
+//most significant byte first: spread the names over buckets by their key byte at depth,
+//then sort each bucket on the next byte, scratch has room for count names
+static void radix_sort(Name *names, Name *scratch, size_t count, size_t depth) {
+    if (count < SMALL_BUCKET) {
+        insertion_sort(names, count, depth);
+        return;
+    }
+    size_t bucket[257] = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        bucket[key_at(&names[i], depth) + 1]++;
+    }
+    for (int b = 1; b < 257; b++) {
+        bucket[b] += bucket[b - 1];     //now where bucket b starts
+    }
+    for (size_t i = 0; i < count; i++) {
+        scratch[bucket[key_at(&names[i], depth)]++] = names[i];
+    }
+    memcpy(names, scratch, count * sizeof(Name));
+    //bucket b now ends where b + 1 starts, and bucket 0 holds the one name that ended, if any
+    for (int b = 1; b < 256; b++) {
+        if (bucket[b] - bucket[b - 1] > 1) {
+            radix_sort(names + bucket[b - 1], scratch, bucket[b] - bucket[b - 1], depth + 1);
+        }
+    }
+}
+
+//whether anything happened in the watched directory since the last look, reads all the events
+static int directory_changed() {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    while (read(events, buffer, sizeof(buffer)) > 0) {
+        changed = 1;
+    }
+    return changed;
+}
+
+//watch path before it is read, so a change while reading already counts against the new listing
+static void watch_directory(const char *path, const struct stat *info) {
+    free(cached.text);
+    cached.text = NULL;
+    if (events < 0) {
+        events = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    if (events < 0) {
+        return;                 //no cache then
+    }
+    if (cached.watch >= 0 && (cached.device != info->st_dev || cached.inode != info->st_ino)) {
+        inotify_rm_watch(events, cached.watch);
+    }
+    directory_changed();        //including the IN_IGNORED of the old watch
+    cached.watch = inotify_add_watch(events, path, LISTING_EVENTS | IN_ONLYDIR);
+    cached.device = info->st_dev;
+    cached.inode = info->st_ino;
+}
+
+//every entry of the open directory fd into arena, which grows a batch at a time, -1 on error
+static ssize_t read_entries(int fd, char **arena, Name **names, size_t *count) {
+    size_t used = 0, size = 0, room = 0;
+    *arena = NULL;
+    *names = NULL;
+    *count = 0;
+    for (;;) {
+        if (size - used < BATCH_SIZE) {
+            size = size * 2 + BATCH_SIZE;
+            char *bigger = realloc(*arena, size);
+            if (!bigger) {
+                return -1;
+            }
+            *arena = bigger;
+        }
+        long got = syscall(SYS_getdents64, fd, *arena + used, size - used);
+        if (got <= 0) {
+            return got < 0 ? -1 : (ssize_t) used;
+        }
+        //the records stay where they are, the names are pointed at in place
+        for (long at = 0; at < got;) {
+            struct linux_dirent64 *entry = (struct linux_dirent64 *) (*arena + used + at);
+            if (*count == room) {
+                room = room * 2 + 1024;
+                Name *more = realloc(*names, room * sizeof(Name));
+                if (!more) {
+                    return -1;
+                }
+                *names = more;
+            }
+            (*names)[(*count)++] = (Name) {
+            .offset = entry->d_name - *arena,.length = strlen(entry->d_name)};
+            at += entry->d_reclen;
+        }
+        used += got;
+    }
+}
+
+//the sorted names one per line, NULL if there isn't memory for it
+static char *sorted_listing(char *arena, size_t used, Name *names, size_t count, size_t *length) {
+    unsigned char *key_buffer = malloc(used ? used : 1);
+    Name *scratch = malloc((count ? count : 1) * sizeof(Name));
+    char *text = NULL;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += names[i].length + 1;
+    }
+    if (key_buffer && scratch && (text = malloc(total ? total : 1))) {
+        for (size_t i = 0; i < count; i++) {
+            for (size_t j = names[i].offset; j < names[i].offset + names[i].length; j++) {
+                key_buffer[j] = rank_of[(unsigned char) arena[j]];
+            }
+        }
+        keys = key_buffer;
+        radix_sort(names, scratch, count, 0);
+        char *at = text;
+        for (size_t i = 0; i < count; i++) {
+            memcpy(at, arena + names[i].offset, names[i].length);
+            at += names[i].length;
+            *at++ = '\n';
+        }
+        *length = total;
+    }
+    free(key_buffer);
+    free(scratch);
+    return text;
+}
+
+int list_directory(const char *path) {
+    if (!rank_of['0']) {
+        rank_characters();
+    }
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        errno = error;
+        return -1;
+    }
+    if (cached.text && cached.device == info.st_dev && cached.inode == info.st_ino && !directory_changed()) {
+        close(fd);
+        fwrite(cached.text, 1, cached.length, stdout);
+        return 0;
+    }
+
+    watch_directory(path, &info);
+    char *arena;
+    Name *names;
+    size_t count, length = 0;
+    ssize_t used = read_entries(fd, &arena, &names, &count);
+    int error = errno;
+    close(fd);
+    char *text = used >= 0 ? sorted_listing(arena, used, names, count, &length) : NULL;
+    free(arena);
+    free(names);
+    if (!text) {
+        errno = used >= 0 ? ENOMEM : error;
+        return -1;
+    }
+    fwrite(text, 1, length, stdout);
+    if (cached.watch >= 0) {
+        cached.text = text;
+        cached.length = length;
+    } else {
+        free(text);
+    }
+    return 0;
+}
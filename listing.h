@@ -0,0 +1,14 @@
+#ifndef LISTING_H
+#   define LISTING_H
+
+//my_ls: every name in a directory, dotfiles included, one per line, digits before letters,
+//letters alphabetically with the capital first when two names differ only in case.
+//The directory is read with getdents64 in big batches straight into one arena, each name
+//gets a sort key (one byte per character, see rank_of), the keys are radix sorted and the
+//listing goes out with one write. The text of the last listing is kept, with an inotify watch
+//on its directory, so listing the same directory again while nothing was created, removed or
+//renamed in it is just that write.
+
+int list_directory(const char *path);   //print the listing of path, returns 0 or -1 with errno set
+
+#endif
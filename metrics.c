@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "metrics.h"
+#include "admission.h"
+#include "groups.h"
+#include "jobs.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "shellmemory.h"
+#include "stats.h"
+
+uint64_t metrics_counters[METRIC_COUNTER_COUNT];
+uint64_t metrics_instructions[POLICY_COUNT];
+uint64_t metrics_switches[POLICY_COUNT];
+uint64_t metrics_interval_ns = 0;
+
+static char *metrics_path = NULL;       //file metrics_tick rewrites
+static uint64_t next_write = 0; //stats_now() when it is due
+
+//names and help text in the same order as the METRIC_* enum
+static const char *counter_names[METRIC_COUNTER_COUNT] = {
+    "mysh_commands_total", "mysh_command_errors_total", "mysh_run_forks_total",
+    "mysh_run_failures_total", "mysh_variable_sets_total", "mysh_deadlines_met_total",
+    "mysh_deadlines_missed_total", "mysh_deadline_lateness_microseconds_total", "mysh_worker_restarts_total",
+    "mysh_auto_switches_total", "mysh_worker_migrations_total", "mysh_worker_node_migrations_total"
+};
+static const char *counter_help[METRIC_COUNTER_COUNT] = {
+    "Commands run, typed or from scripts.",
+    "Commands that returned an error.",
+    "Processes started by run.",
+    "run commands whose fork failed or whose program exited with a non-zero status.",
+    "Values stored in shell variables.",
+    "Processes with an EDF deadline that finished by it.",
+    "Processes with an EDF deadline that finished after it.",
+    "How late the processes that missed their EDF deadline finished, added up.",
+    "Worker processes started again because one was killed.",
+    "Times the AUTO policy switched strategy.",
+    "Processes that went on running on a different worker than the one that last ran them.",
+    "Of those, the ones that moved to a worker pinned to another NUMA node."
+};
+
+static void header(FILE *out, const char *name, const char *type, const char *help) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void gauge(FILE *out, const char *name, const char *help, long long value) {
+    header(out, name, "gauge", help);
+    fprintf(out, "%s %lld\n", name, value);
+}
+
+static void counter(FILE *out, const char *name, const char *help, uint64_t value) {
+    header(out, name, "counter", help);
+    fprintf(out, "%s %llu\n", name, (unsigned long long) value);
+}
+
+static void per_policy(FILE *out, const char *name, const char *help, uint64_t values[]) {
+    header(out, name, "counter", help);
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        fprintf(out, "%s{policy=\"%s\"} %llu\n", name, policy_name(i), (unsigned long long) values[i]);
+    }
+}
+
+void metrics_print(FILE *out) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        counter(out, counter_names[i], counter_help[i], metrics_counters[i]);
+    }
+    per_policy(out, "mysh_instructions_total", "Script instructions run, by the policy that ran them.",
+               metrics_instructions);
+    per_policy(out, "mysh_context_switches_total",
+               "Dispatches of a different process than the one dispatched before.", metrics_switches);
+    counter(out, "mysh_admission_waits_total", "Programs that waited in the admission queue before they ran.",
+            admission_counters.waited);
+    counter(out, "mysh_admission_rejections_total", "exec and dag calls turned away because the admission queue was full.",
+            admission_counters.rejected);
+    counter(out, "mysh_page_faults_total", "Pages loaded because a process reached a page that wasn't in memory.",
+            paging_counters.faults);
+    counter(out, "mysh_page_evictions_total", "Pages thrown out of program memory to make room.",
+            paging_counters.evictions);
+
+    //a frame holds one page, the last page of a script may not fill it
+    int used = 0, fragmented = 0;
+    for (int frame = 0; frame < FRAME_COUNT; frame++) {
+        PCB *owner = shell_program_memory.owner[frame];
+        if (owner) {
+            int lines = owner->number_of_lines - shell_program_memory.page[frame] * FRAME_SIZE;
+            used += lines < FRAME_SIZE ? lines : FRAME_SIZE;
+            fragmented += lines < FRAME_SIZE ? FRAME_SIZE - lines : 0;
+        }
+    }
+    int variables = 0;
+    for (int slot = 0; slot < mem_slot_count(); slot++) {
+        variables += mem_get_slot(slot) != NULL;
+    }
+    long long depth = groups_queued() + (foreground_queue ? foreground_queue->size : 0);
+
+    gauge(out, "mysh_ready_queue_depth", "Processes waiting in ready queues, foreground and background.", depth);
+    gauge(out, "mysh_admission_pending", "Programs waiting in the admission queue.", admission_counters.pending);
+    gauge(out, "mysh_program_memory_lines", "Lines program memory can hold.", FRAME_COUNT * FRAME_SIZE);
+    gauge(out, "mysh_program_memory_lines_used", "Lines of program memory holding a script line.", used);
+    gauge(out, "mysh_program_memory_lines_fragmented",
+          "Lines of program memory in frames that are in use but holding no script line.", fragmented);
+    gauge(out, "mysh_variables", "Shell variables that have a value.", variables);
+}
+
+int metrics_write(const char *path) {
+    char temporary[strlen(path) + sizeof(".tmp")];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *out = fopen(temporary, "w");
+    if (!out) {
+        return -1;
+    }
+    metrics_print(out);
+    if (fclose(out) != 0 || rename(temporary, path) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_schedule(const char *path, int seconds) {
+    free(metrics_path);
+    metrics_path = seconds > 0 ? strdup(path) : NULL;
+    metrics_interval_ns = seconds > 0 ? (uint64_t) seconds * 1000000000u : 0;
+    next_write = stats_now() + metrics_interval_ns;
+}
+
+void metrics_tick() {
+    uint64_t now = stats_now();
+    if (now < next_write) {
+        return;
+    }
+    next_write = now + metrics_interval_ns;
+    if (metrics_write(metrics_path) != 0) {
+        printf("error: can't write metrics to %s, periodic metrics stopped\n", metrics_path);
+        metrics_schedule(NULL, 0);
+    }
+}
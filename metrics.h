@@ -0,0 +1,42 @@
+#ifndef METRICS_H
+#   define METRICS_H
+
+#   include <stdio.h>
+#   include <stdint.h>
+
+//Metrics: counters and gauges in the Prometheus text exposition format.
+//  metrics                 print them
+//  metrics PATH [SECONDS]  write them to PATH now and, with SECONDS, again every SECONDS seconds
+//                          while the shell runs commands or scripts, 0 stops
+//PATH is written to PATH.tmp and renamed, so a node exporter textfile collector never sees half a file.
+//Counters are incremented where things happen, gauges (queue depth, program memory, variables)
+//are worked out from the live state when the metrics are read.
+
+//counters that aren't per policy
+enum {
+    METRIC_COMMANDS,            //commands interpreter() ran, typed or from scripts
+    METRIC_COMMAND_ERRORS,      //those that returned an error
+    METRIC_RUN_FORKS,           //processes run started
+    METRIC_RUN_FAILURES,        //run commands whose fork failed or whose program didn't exit with 0
+    METRIC_VARIABLE_SETS,       //values stored in shell memory
+    METRIC_DEADLINES_MET,       //EDF processes that finished by their deadline
+    METRIC_DEADLINES_MISSED,    //and those that didn't
+    METRIC_DEADLINE_LATENESS_US,        //how late those were, added up, in microseconds
+    METRIC_WORKER_RESTARTS,     //workers started again after one was killed, see workers.h
+    METRIC_AUTO_SWITCHES,       //strategies AUTO switched to, see scheduler.h
+    METRIC_WORKER_MIGRATIONS,   //processes a worker took over from another one, see workers.h
+    METRIC_WORKER_NODE_MIGRATIONS,      //those where the other worker was pinned to another NUMA node
+    METRIC_COUNTER_COUNT
+};
+
+extern uint64_t metrics_counters[METRIC_COUNTER_COUNT];
+extern uint64_t metrics_instructions[]; //script instructions run, indexed by POLICY_* from scheduler.h
+extern uint64_t metrics_switches[];     //dispatches of a different process than the one dispatched before, indexed by POLICY_*
+extern uint64_t metrics_interval_ns;    //how often the metrics file is rewritten, 0 if there is none
+
+void metrics_print(FILE * out);
+int metrics_write(const char *path);    //replace path with the current metrics, returns 0 or -1
+void metrics_schedule(const char *path, int seconds);   //rewrite path every seconds seconds, 0 stops
+void metrics_tick();            //rewrite the metrics file if it is due, call only when metrics_interval_ns is set
+
+#endif
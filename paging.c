@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "paging.h"
+#include "shellmemory.h"
+#include "stats.h"
+
+int replacement_policy = REPLACE_LRU;
+PagingCounters paging_counters;
+
+static unsigned long use_clock = 0;     //ticks on every line fetched, stamps last_used for LRU
+static int clock_hand = 0;      //next frame CLOCK looks at
+
+//read a file's lines the way scripts have always been read: fgets into a line sized buffer,
+//so a line longer than a ProgramLine carries on into the next one
+static int read_line(FILE *file, ProgramLine line) {
+    if (fgets(line, MAX_PROGRAM_LINE_LENGTH, file) == NULL) {
+        return 0;
+    }
+    line[strcspn(line, "\r\n")] = '\0'; //find the index of the first return or newline char and replace it with null terminator char
+    return 1;
+}
+
+//note where every page of file starts
+static BackingStore *index_pages(FILE *file) {
+    BackingStore *backing = malloc(sizeof(BackingStore));
+    int capacity = 16;          //grown as needed, scripts are usually short
+    backing->file = file;
+    backing->page_offsets = malloc(capacity * sizeof(long));
+    backing->page_count = 0;
+    backing->line_count = 0;
+
+    ProgramLine line;
+    long offset = ftell(file);
+    while (read_line(file, line)) {
+        if (backing->line_count % FRAME_SIZE == 0) {    //first line of a new page
+            if (backing->page_count == capacity) {
+                capacity *= 2;
+                backing->page_offsets = realloc(backing->page_offsets, capacity * sizeof(long));
+            }
+            backing->page_offsets[backing->page_count++] = offset;
+        }
+        backing->line_count++;
+        offset = ftell(file);
+    }
+    return backing;
+}
+
+BackingStore *backing_open(const char *path) {
+    FILE *file = fopen(path, "rt");
+    if (!file) {
+        return NULL;
+    }
+    return index_pages(file);
+}
+
+BackingStore *backing_from_stream(FILE *stream) {
+    FILE *file = tmpfile();     //already unlinked, it goes away when it is closed
+    if (!file) {
+        perror("mysh: tmpfile");
+        return NULL;
+    }
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), stream)) > 0) {
+        fwrite(buffer, 1, n, file);
+    }
+    rewind(file);
+
+    BackingStore *backing = index_pages(file);
+    if (backing->line_count == 0) {     //if there was nothing else after
+        backing_close(backing);
+        return NULL;
+    }
+    return backing;
+}
+
+void backing_load(BackingStore *backing, ProgramLine lines[]) {
+    if (backing->page_count == 0) {
+        return;
+    }
+    fseek(backing->file, backing->page_offsets[0], SEEK_SET);
+    for (int i = 0; i < backing->line_count && read_line(backing->file, lines[i]); i++);
+}
+
+long backing_copy(BackingStore *backing, FILE *out) {
+    if (backing->page_count == 0) {
+        return 0;
+    }
+    //lines are read the way index_pages counted them, so the copy indexes into the same lines
+    ProgramLine line;
+    long written = 0;
+    fseek(backing->file, backing->page_offsets[0], SEEK_SET);
+    for (int i = 0; i < backing->line_count && read_line(backing->file, line); i++) {
+        size_t length = strlen(line);
+        line[length] = '\n';
+        if (fwrite(line, 1, length + 1, out) != length + 1) {
+            return -1;
+        }
+        written += length + 1;
+    }
+    return written;
+}
+
+void backing_close(BackingStore *backing) {
+    if (!backing) {
+        return;
+    }
+    fclose(backing->file);
+    free(backing->page_offsets);
+    free(backing);
+}
+
+//frames a process is promised while it runs: enough for its first pages
+static int reserve_of(PCB *pcb) {
+    return pcb->page_count < INITIAL_PAGES ? pcb->page_count : INITIAL_PAGES;
+}
+
+int paging_has_room(PCB *pcb) {
+    return paging_counters.reserved_frames + reserve_of(pcb) <= FRAME_COUNT;
+}
+
+//pick a frame to throw out, every frame is in use when this is called
+static int choose_victim() {
+    if (replacement_policy == REPLACE_CLOCK) {
+        while (shell_program_memory.referenced[clock_hand]) {
+            shell_program_memory.referenced[clock_hand] = 0;    //second chance
+            clock_hand = (clock_hand + 1) % FRAME_COUNT;
+        }
+        int victim = clock_hand;
+        clock_hand = (clock_hand + 1) % FRAME_COUNT;
+        return victim;
+    }
+    int victim = 0;
+    for (int i = 1; i < FRAME_COUNT; i++) {
+        if (shell_program_memory.last_used[i] < shell_program_memory.last_used[victim]) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+//get a frame for a page, evicting one if memory is full
+static int take_frame() {
+    int frame = allocate_frame();
+    if (frame >= 0) {
+        return frame;
+    }
+    frame = choose_victim();
+    PCB *owner = shell_program_memory.owner[frame];
+    owner->page_table[shell_program_memory.page[frame]] = -1;   //its owner faults it back in if it gets there again
+    owner->usage.frames_held--;
+    free_frame(frame);
+    paging_counters.evictions++;
+    return allocate_frame();
+}
+
+//copy one page from the backing store into a frame
+static void load_page(PCB *pcb, int page) {
+    int frame = take_frame();
+    BackingStore *backing = pcb->backing;
+    int first = page * FRAME_SIZE;
+    int count = backing->line_count - first < FRAME_SIZE ? backing->line_count - first : FRAME_SIZE;
+
+    fseek(backing->file, backing->page_offsets[page], SEEK_SET);
+    for (int i = 0; i < count; i++) {
+        read_line(backing->file, shell_program_memory.lines[frame * FRAME_SIZE + i]);
+    }
+    intern_program_lines(frame * FRAME_SIZE, count);    //resolve its variable names once, now
+
+    shell_program_memory.owner[frame] = pcb;
+    shell_program_memory.page[frame] = page;
+    shell_program_memory.last_used[frame] = ++use_clock;
+    shell_program_memory.referenced[frame] = 1;
+    pcb->page_table[page] = frame;
+    if (++pcb->usage.frames_held > pcb->usage.peak_frames) {
+        pcb->usage.peak_frames = pcb->usage.frames_held;
+    }
+}
+
+void load_initial_pages(PCB *pcb) {
+    if (!pcb->backing) {
+        return;
+    }
+    paging_counters.reserved_frames += reserve_of(pcb);
+    for (int page = 0; page < reserve_of(pcb); page++) {
+        load_page(pcb, page);
+        paging_counters.loads++;
+    }
+}
+
+int fetch_line(PCB *pcb, int pc) {
+    int page = pc / FRAME_SIZE;
+    int frame = pcb->page_table[page];
+    if (frame < 0) {            //page fault
+        uint64_t start = stats_now();
+        load_page(pcb, page);
+        frame = pcb->page_table[page];
+        paging_counters.faults++;
+        stats_record(&stats_commands[STAT_PAGE_FAULT], stats_now() - start);
+    }
+    shell_program_memory.last_used[frame] = ++use_clock;
+    shell_program_memory.referenced[frame] = 1;
+    return frame * FRAME_SIZE + pc % FRAME_SIZE;
+}
+
+void release_pages(PCB *pcb) {
+    if (!pcb->backing) {
+        return;
+    }
+    for (int page = 0; page < pcb->page_count; page++) {
+        free_frame(pcb->page_table[page]);      //free_frame ignores pages that aren't loaded
+    }
+    pcb->usage.frames_held = 0;
+    paging_counters.reserved_frames -= reserve_of(pcb);
+    backing_close(pcb->backing);
+    pcb->backing = NULL;
+}
+
+void paging_print() {
+    printf("replacement: %s, frames: %d of %d in use, %d reserved, %d lines each\n",
+           replacement_policy == REPLACE_LRU ? "LRU" : "CLOCK", shell_program_memory.frames_used, FRAME_COUNT,
+           paging_counters.reserved_frames, FRAME_SIZE);
+    printf("loads: %llu, faults: %llu, evictions: %llu\n",
+           (unsigned long long) paging_counters.loads,
+           (unsigned long long) paging_counters.faults, (unsigned long long) paging_counters.evictions);
+}
@@ -0,0 +1,52 @@
+#ifndef PAGING_H
+#   define PAGING_H
+
+#   include <stdio.h>
+#   include <stdint.h>
+#   include "pcb.h"
+#   include "shellmemory.h"
+
+//Demand paging: a script stays in its file (its backing store) and is split into pages of
+//FRAME_SIZE lines. exec only loads the first INITIAL_PAGES pages of each script into program
+//memory, the rest are loaded by a page fault when pc first reaches them. When every frame is
+//in use a page is evicted with the replacement policy, its owner faults it back in if it needs it again.
+
+#   define INITIAL_PAGES 2      //pages loaded before a script first runs
+
+//page replacement policies
+enum {
+    REPLACE_LRU,                //evict the page that was read longest ago
+    REPLACE_CLOCK               //second chance: sweep the frames, skip and clear any that were read since the last sweep
+};
+
+//where a script's pages are loaded from
+typedef struct BackingStore {
+    FILE *file;                 //script, kept open for as long as the process lives
+    long *page_offsets;         //file offset each page starts at
+    int page_count;
+    int line_count;
+} BackingStore;
+
+typedef struct PagingCounters {
+    uint64_t loads;             //pages loaded up front by load_initial_pages
+    uint64_t faults;            //pages loaded because pc reached a page that wasn't in memory
+    uint64_t evictions;         //pages thrown out to make room
+    int reserved_frames;        //frames promised to admitted processes, see paging_has_room
+} PagingCounters;
+
+extern int replacement_policy;  //REPLACE_* currently in use
+extern PagingCounters paging_counters;
+
+BackingStore *backing_open(const char *path);   //index a script file, NULL if it can't be opened
+BackingStore *backing_from_stream(FILE * stream);       //copy whatever is left of stream to a temporary backing store, NULL if nothing is left
+void backing_close(BackingStore * backing);
+void backing_load(BackingStore * backing, ProgramLine lines[]);  //read every line of the script into lines, line_count of them
+long backing_copy(BackingStore * backing, FILE * out);   //write every line of the script to out, one per line, returns the bytes written or -1
+
+int paging_has_room(PCB * pcb); //whether pcb can be admitted without overcommitting frames
+void load_initial_pages(PCB * pcb);     //load the first pages of a new process, evicting if needed
+int fetch_line(PCB * pcb, int pc);      //index in shell_program_memory of line pc, faulting its page in if needed
+void release_pages(PCB * pcb);  //free every frame pcb holds and close its backing store
+void paging_print();            //print the counters
+
+#endif
@@ -1,8 +1,11 @@
 #include <stdlib.h>
+#include <string.h>
 #include "pcb.h"
+#include "shellmemory.h"
+#include "stats.h"
 
 //Create a new PCB with initial values
-PCB *create_pcb(int pid, int start_index, int number_of_lines) {
+PCB *create_pcb(int pid, struct BackingStore *backing, int number_of_lines) {
     PCB *new_pcb = (PCB *) malloc(sizeof(PCB)); //malloc allocates enough memory to store 1 PCB struct
     //cast the return pointer to type PCB *
     //so now new_pcb points to a block of memory large enough to hold the PCB
@@ -12,12 +15,57 @@ PCB *create_pcb(int pid, int start_index, int number_of_lines) {
     }
     //initialize PCB fields
     new_pcb->pid = pid;
-    new_pcb->start_index = start_index;
+    new_pcb->backing = backing;
+    new_pcb->page_table = NULL;
+    new_pcb->page_count = 0;
+    if (backing) {              //nothing is loaded yet, every page starts out missing
+        new_pcb->page_count = (number_of_lines + FRAME_SIZE - 1) / FRAME_SIZE;
+        new_pcb->page_table = malloc(new_pcb->page_count * sizeof(int));
+        for (int i = 0; i < new_pcb->page_count; i++) {
+            new_pcb->page_table[i] = -1;
+        }
+    }
     new_pcb->number_of_lines = number_of_lines;
     new_pcb->pc = 0;            //set to zero since execution starts at 1st line
     new_pcb->next = NULL;       //initally not linked to other PCB
     new_pcb->job_length_score = number_of_lines;        //in the beginning, job length score = number of lines of code in the script
+    new_pcb->aged_at = 0;       //set properly when it is enqueued
     new_pcb->is_batch_script = 0;       //default set to false (0)
+    pcb_set_tickets(new_pcb, DEFAULT_TICKETS);  //everyone gets the same share unless told otherwise
+    new_pcb->pass = 0;          //lifted to the queue's virtual time when it first joins a STRIDE queue
+    new_pcb->heap_order = 0;    //set when it joins an SJF or AGING heap
+    new_pcb->slot = -1;         //and a LOTTERY ticket tree
+    new_pcb->relative_deadline = 0;     //no deadline unless EDF:MILLISECONDS gives it one
+    new_pcb->deadline = 0;
+    memset(&new_pcb->usage, 0, sizeof(Usage));
+    new_pcb->usage.created = stats_now();
+    new_pcb->over_quota = -1;
+    new_pcb->scope = NULL;      //the global variables unless a job gives it its own
+    new_pcb->job_id = 0;        //not part of a daemon job unless the daemon says so
+    new_pcb->parent = NULL;     //see adopt_child
+    new_pcb->children = 0;
+    new_pcb->blocked = 0;
+    new_pcb->exited = EXITED_NOT;
+    new_pcb->wake_queue = NULL;
+    new_pcb->wake_policy = 0;
 
     return new_pcb;             //returns pointer to newly allocated PCB
 }
+
+//more tickets means a smaller stride, so the PCB's pass grows slower and it gets picked more often
+void pcb_set_tickets(PCB *pcb, int tickets) {
+    pcb->tickets = tickets;
+    pcb->stride = STRIDE1 / tickets;
+}
+
+//the deadline is absolute from here on, time spent waiting for admission or in the queue counts
+void pcb_set_deadline(PCB *pcb, int milliseconds) {
+    pcb->relative_deadline = milliseconds;
+    pcb->deadline = milliseconds > 0 ? stats_now() + (uint64_t) milliseconds * 1000000 : 0;
+}
+
+//PIDs are shared by source, exec and the daemon so they never collide
+int allocate_pid() {
+    static int next_pid = 1;
+    return next_pid++;
+}
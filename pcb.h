@@ -1,16 +1,61 @@
 #ifndef PCB_H
 #   define PCB_H
 
+#   include <stdint.h>
+
+#   define DEFAULT_TICKETS 100  //share a job gets under STRIDE and LOTTERY unless it asks for another
+#   define STRIDE1 (1 << 20)     //pass a job with one ticket advances by per instruction, see pcb_set_tickets
+#   define EDF_MAX_DEADLINE 86400000    //longest EDF deadline, a day in milliseconds
+
+//what happened to a process that exited while it still had children
+enum { EXITED_NOT, EXITED_FINISHED, EXITED_KILLED };
+
+//what a process used, see quotas.h
+typedef struct Usage {
+    uint64_t instructions;      //lines it ran
+    uint64_t cpu_ns;            //CPU time the shell spent running them, only measured while accounting_on
+    uint64_t run_cpu_ns;        //CPU time of the programs its run commands started, from wait4
+    uint64_t created;           //stats_now() when it was created, its wall time counts from here
+    int runs;                   //programs its run commands started
+    int variables_written;      //set commands it ran
+    int frames_held;            //frames of program memory its pages are in right now
+    int peak_frames;            //most it held at once
+} Usage;
+
 //PCB struct for a script process
 typedef struct PCB {
     int pid;                    //each process has unique PID
-    int start_index;            //Spot in shell memory where script instructions are loaded, keeping track of start position of script
+    struct BackingStore *backing;       //file the script's pages are loaded from, NULL for simulated processes
+    int *page_table;            //frame each page of the script is loaded in, -1 if it isn't
+    int page_count;             //number of pages the script is split into
     int number_of_lines;        //Keeping track of the length of the script
     int pc;                     //program counter, but really an index of the next instruction for an array of program lines
-    int job_length_score;       //for AGING policy
+    int job_length_score;       //for AGING policy, as of when the PCB was last enqueued (see queued_score)
+    long aged_at;               //the queue's aging total when this PCB was enqueued
+    int queued_lines;           //lines it had left when it was enqueued, what comes off the queue's totals when it leaves
     int is_batch_script;        //flag to signal whether PCB is for a batch script process
+    int tickets;                //share of the CPU under STRIDE and LOTTERY, relative to the other PCBs
+    long stride;                //STRIDE1 / tickets, how far pass moves per instruction run
+    long pass;                  //STRIDE virtual time, the PCB with the lowest pass runs next
+    long heap_order;            //SJF and AGING heap: breaks ties in job length score, lowest first, see score_push
+    int slot;                   //LOTTERY: where its tickets are in the queue's ticket tree, see ticket_push
+    int relative_deadline;      //EDF: milliseconds it was given to finish in, 0 if it has no deadline
+    uint64_t deadline;          //EDF: stats_now() it should be done by, the PCB with the earliest runs next
+    Usage usage;                //what it used so far
+    int over_quota;             //QUOTA_* limit it went over first, -1 if none, see quotas.h
+    struct Scope *scope;        //variables its lines see, NULL for the global ones, see scopes.h
+    int job_id;                 //daemon or background job this process belongs to, 0 for a foreground exec
+    struct PCB *parent;         //process whose exec or source started it, NULL if it was started at the prompt
+    int children;               //processes it started that haven't finished, it isn't freed before they are
+    int blocked;                //waiting for its children, it is in no queue until they finish
+    int exited;                 //EXITED_* once its own program is done
+    struct ReadyQueue *wake_queue;      //queue it rejoins when it stops being blocked
+    int wake_policy;            //and the policy running that queue
     struct PCB *next;           //pointer which will point to the next PCB in the ready queue
 } PCB;
 
-PCB *create_pcb(int pid, int start_index, int number_of_lines); // Function that'll create a new PCB
+PCB *create_pcb(int pid, struct BackingStore *backing, int number_of_lines); // Function that'll create a new PCB
+void pcb_set_tickets(PCB * pcb, int tickets);   // Function that gives a PCB its STRIDE/LOTTERY share
+void pcb_set_deadline(PCB * pcb, int milliseconds);     // Function that gives a PCB its EDF deadline, counted from now, 0 for none
+int allocate_pid();             // Function that hands out the next unique PID
 #endif
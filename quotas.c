@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "quotas.h"
+#include "scheduler.h"
+#include "shellmemory.h"
+#include "stats.h"
+
+int accounting_on = 0;
+
+static uint64_t limits[QUOTA_COUNT];    //0 if there is no limit
+static int actions[QUOTA_COUNT];        //QUOTA_KILL or QUOTA_LOWER
+static int reports = 0;
+
+//in the same order as the QUOTA_* enum
+static const char *resource_names[QUOTA_COUNT] = { "instructions", "cpu", "wall", "runs", "variables", "lines" };
+
+int quota_from_name(const char *name) {
+    for (int i = 0; i < QUOTA_COUNT; i++) {
+        if (strcmp(name, resource_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void update_accounting() {
+    accounting_on = reports;
+    for (int i = 0; i < QUOTA_COUNT; i++) {
+        accounting_on |= limits[i] != 0;
+    }
+}
+
+void quota_set(int resource, uint64_t limit, int action) {
+    limits[resource] = limit;
+    actions[resource] = action;
+    update_accounting();
+}
+
+void quota_reports(int on) {
+    reports = on;
+    update_accounting();
+}
+
+void quota_print() {
+    for (int i = 0; i < QUOTA_COUNT; i++) {
+        if (limits[i]) {
+            printf("%-13s %llu%s %s\n", resource_names[i], (unsigned long long) limits[i],
+                   i == QUOTA_CPU || i == QUOTA_WALL ? "ms" : "", actions[i] == QUOTA_KILL ? "kill" : "lower");
+        } else {
+            printf("%-13s off\n", resource_names[i]);
+        }
+    }
+    printf("%-13s %s\n", "report", reports ? "on" : "off");
+}
+
+uint64_t quota_cpu_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+//how much of resource pcb used, in the unit its limit is given in
+static uint64_t used(PCB *pcb, int resource) {
+    Usage *usage = &pcb->usage;
+    switch (resource) {
+    case QUOTA_INSTRUCTIONS:
+        return usage->instructions;
+    case QUOTA_CPU:
+        return (usage->cpu_ns + usage->run_cpu_ns) / 1000000;
+    case QUOTA_WALL:
+        return (stats_now() - usage->created) / 1000000;
+    case QUOTA_RUNS:
+        return usage->runs;
+    case QUOTA_VARIABLES:
+        return usage->variables_written;
+    default:
+        return (uint64_t) usage->frames_held * FRAME_SIZE;
+    }
+}
+
+//put pcb behind every other process under the policies that rank them
+static void lower(PCB *pcb) {
+    pcb->job_length_score = MAX_PROGRAM_SIZE;   //longer than any script can be
+    pcb_set_tickets(pcb, 1);
+    pcb->deadline = 0;          //no deadline runs after every deadline, and isn't counted as met or missed
+}
+
+int quota_check(PCB *pcb) {
+    if (pcb->pc >= pcb->number_of_lines) {
+        return 0;               //nothing left it could use more with
+    }
+    for (int i = 0; i < QUOTA_COUNT; i++) {
+        if (!limits[i] || used(pcb, i) < limits[i]) {
+            continue;
+        }
+        if (actions[i] == QUOTA_KILL) {
+            pcb->over_quota = i;
+            return 1;
+        }
+        if (pcb->over_quota < 0) {      //lowered once, it can't go any lower
+            pcb->over_quota = i;
+            lower(pcb);
+        }
+    }
+    return 0;
+}
+
+void quota_finished(PCB *pcb) {
+    if (!reports) {
+        return;
+    }
+    Usage *usage = &pcb->usage;
+    printf("process %d: %llu instructions, cpu %.1fms + run %.1fms, wall %.1fms, %d runs, %d variables, %d lines",
+           pcb->pid, (unsigned long long) usage->instructions, usage->cpu_ns / 1000000.0, usage->run_cpu_ns / 1000000.0,
+           (stats_now() - usage->created) / 1000000.0, usage->runs, usage->variables_written,
+           usage->peak_frames * FRAME_SIZE);
+    if (pcb->over_quota >= 0) {
+        printf(", %s over its %s quota", actions[pcb->over_quota] == QUOTA_KILL ? "killed" : "lowered",
+               resource_names[pcb->over_quota]);
+    } else if (pcb->exited == EXITED_KILLED) {
+        printf(", killed");
+    }
+    printf("\n");
+}
@@ -0,0 +1,47 @@
+#ifndef QUOTAS_H
+#   define QUOTAS_H
+
+#   include <stdint.h>
+#   include "pcb.h"
+
+//Accounting and quotas: every PCB counts what it used (Usage in pcb.h): instructions, program
+//memory it holds, variables it sets, programs its run commands start and their CPU time (from
+//wait4), the CPU time of its own instructions and the wall time since it was created.
+//  quota                               print the limits
+//  quota RESOURCE LIMIT [kill|lower]   limit every process from now on, kill is the default
+//  quota RESOURCE off                  drop a limit
+//  quota report on|off                 print what each process used when it finishes
+//RESOURCE is instructions, cpu (milliseconds, its instructions and its run programs together),
+//wall (milliseconds), runs, variables or lines (of program memory held at once).
+//Limits are checked after every instruction. A process that reached one and has lines left is
+//killed there, as if its script ended, or lowered: it keeps running but behind the others,
+//its score goes to the back under AGING, its tickets down to 1 under STRIDE and LOTTERY, its
+//deadline away under EDF.
+//FCFS, SJF, RR and RR30 have no priority to lower, there it only shows in the report.
+//The CPU clock is only read while a limit is set or reports are on, the counters are always kept.
+
+//resources a quota can limit
+enum {
+    QUOTA_INSTRUCTIONS,
+    QUOTA_CPU,
+    QUOTA_WALL,
+    QUOTA_RUNS,
+    QUOTA_VARIABLES,
+    QUOTA_LINES,
+    QUOTA_COUNT
+};
+
+//what happens to a process over a limit
+enum { QUOTA_KILL, QUOTA_LOWER };
+
+extern int accounting_on;       //a limit is set or reports are on, instructions are timed
+
+int quota_from_name(const char *name);  //QUOTA_* for a resource name, -1 if there is no such resource
+void quota_set(int resource, uint64_t limit, int action);       //0 drops the limit
+void quota_reports(int on);
+void quota_print();
+uint64_t quota_cpu_now();       //CPU time the shell used so far, in nanoseconds
+int quota_check(PCB * pcb);     //act on the limits pcb went over, returns 1 if it has to end now
+void quota_finished(PCB * pcb); //pcb and its children are done, report it if reports are on
+
+#endif
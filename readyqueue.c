@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include "readyqueue.h"
 
 //create a new empty ready queue with initial values
@@ -14,17 +15,65 @@ ReadyQueue *create_queue() {
     queue->head = NULL;         //no PCB at the head
     queue->tail = NULL;         //no PCB at the tail
     queue->size = 0;            //empty queue initially
+    queue->aged = 0;            //nothing aged yet
+    queue->sorted = 0;          //nothing sorted yet
+    queue->heap = NULL;         //only allocated once STRIDE uses the queue
+    memset(&queue->automatic, 0, sizeof(AutoState));    //AUTO looks at the queue before its first dispatch
+    queue->heap_size = 0;
+    queue->heap_capacity = 0;
+    queue->pass = 0;
+    queue->by_deadline = 0;     //only while EDF runs it
+    queue->by_length = 0;       //only while AUTO runs it as SJF
+    queue->by_score = 0;        //only while SJF or AGING runs it
+    queue->next_order = 0;
+    queue->slots = NULL;        //only allocated once LOTTERY uses the queue
+    queue->ticket_tree = NULL;
+    queue->slot_count = 0;
+    queue->slot_capacity = 0;
+    queue->ticket_total = 0;
+    queue->lines_left = 0;
+    queue->lines_left_squares = 0;
     return queue;               //returns pointer to newly created empty queue
 }
 
 //free memory allocated for the queue struct itself
 void destroy_queue(ReadyQueue *queue) {
+    free(queue->heap);
+    free(queue->slots);
+    free(queue->ticket_tree);
     free(queue);
 }
 
+//Aging is lazy: age_queue only bumps queue->aged, and a PCB's real score is its stored score
+//minus whatever the queue aged since the PCB went in. Every queued PCB ages by the same amount,
+//so this never changes their order, and aging costs the same no matter how long the queue is.
+int queued_score(ReadyQueue *queue, PCB *pcb) {
+    long score = pcb->job_length_score - (queue->aged - pcb->aged_at);
+    return score > 0 ? (int) score : 0; //never below 0
+}
+
+//a PCB goes into the queue (list or heap): count it in the totals, with the lines it has left now
+static void count_in(ReadyQueue *queue, PCB *pcb) {
+    long long left = pcb->number_of_lines - pcb->pc;
+    pcb->queued_lines = (int) left;
+    queue->lines_left += left;
+    queue->lines_left_squares += left * left;
+    queue->size++;
+}
+
+//and out again, taking off what it added, it can't have run in between
+static void count_out(ReadyQueue *queue, PCB *pcb) {
+    long long left = pcb->queued_lines;
+    queue->lines_left -= left;
+    queue->lines_left_squares -= left * left;
+    queue->size--;
+}
+
 //add a PCB to tail of the queue
 void enqueue(ReadyQueue *queue, PCB *process) {
     process->next = NULL;       //process will be last in queue so set NEXT to null
+    process->aged_at = queue->aged;     //it hasn't aged in this queue yet
+    queue->sorted = 0;          //the tail is wherever it lands, not in job length order
 
     if (!queue->head) {         //if queue is empty
         //let head and tail both point to PCB
@@ -35,7 +84,7 @@ void enqueue(ReadyQueue *queue, PCB *process) {
         queue->tail = process;  //update tail pointer
     }
 
-    queue->size++;              //increment size of queue to keep track of number of PCBs in queue
+    count_in(queue, process);   //increment size of queue to keep track of number of PCBs in queue
 }
 
 //remove a PCB from the head of the queue
@@ -45,6 +94,7 @@ PCB *dequeue(ReadyQueue *queue) {
     }
 
     PCB *process = queue->head; //save the head(first PCB in queue)
+    process->job_length_score = queued_score(queue, process);   //apply the aging it got while waiting
     queue->head = queue->head->next;    //move head to next PCB in queue
 
     if (!queue->head) {         //if the queue is NOW empty
@@ -52,7 +102,7 @@ PCB *dequeue(ReadyQueue *queue) {
     }
 
     process->next = NULL;       //remove the process completely from the queue
-    queue->size--;              //decrement queue size
+    count_out(queue, process);  //decrement queue size
     return process;             //return the dequeued PCB we saved earlier
 }
 
@@ -65,20 +115,21 @@ int is_empty(ReadyQueue *queue) {
 
 //Works like an insertion sort, adding PCB to correct part of queue
 void enqueueAGING(ReadyQueue *queue, PCB *pcb) {
+    pcb->aged_at = queue->aged; //it hasn't aged in this queue yet
     //if queue is empty or the dequeued job has a score <= the head of the queue, insert dequeued job into the front
     if (!queue->head
-        || (pcb->job_length_score <= queue->head->job_length_score)) {
+        || (pcb->job_length_score <= queued_score(queue, queue->head))) {
         pcb->next = queue->head;        //have dequeued PCB's next pointer point to the current head
         queue->head = pcb;      //dequeued PCB becomes new head
         if (!queue->tail) {     // if queue was orginally empty, aka no tail
             queue->tail = pcb;  // update tail
         }
-        queue->size++;          //increment size of queue to keep track of number of PCBs in queue
+        count_in(queue, pcb);   //increment size of queue to keep track of number of PCBs in queue
         return;
     }
     //if not, we must find where to insert dequeued PCB
     PCB *current = queue->head; //get the head of queue
-    while (current->next && current->next->job_length_score < pcb->job_length_score) {  //loop through queue until we reach the end
+    while (current->next && queued_score(queue, current->next) < pcb->job_length_score) {       //loop through queue until we reach the end
         //or the current job's score is less than dequeued job's score
         current = current->next;        //move to next node in queue
     }
@@ -89,12 +140,13 @@ void enqueueAGING(ReadyQueue *queue, PCB *pcb) {
     if (!pcb->next) {           //if pcb inserted at the end, aka no node after it
         queue->tail = pcb;      //update tail
     }
-    queue->size++;              //increment size of queue to keep track of number of PCBs in queue
+    count_in(queue, pcb);       //increment size of queue to keep track of number of PCBs in queue
     return;
 }
 
 //will insert batch script pcb at the front of queue
 void enqueueFront(ReadyQueue *queue, PCB *pcb) {
+    pcb->aged_at = queue->aged; //it hasn't aged in this queue yet
     if (queue->head == NULL) {  //if queue is empty, use regular enqueue
         //let head and tail both point to PCB
         queue->head = pcb;
@@ -104,6 +156,239 @@ void enqueueFront(ReadyQueue *queue, PCB *pcb) {
         pcb->next = queue->head;        //link pcb's next pointer to current head
         queue->head = pcb;      //set new head to be pcb
     }
-    queue->size++;              //increment size of queue to keep track of number of PCBs in queue
+    count_in(queue, pcb);       //increment size of queue to keep track of number of PCBs in queue
     return;
 }
+
+//merge two sorted lists, taking from a first on ties so equal jobs keep their order
+static PCB *merge_by_length(PCB *a, PCB *b) {
+    PCB head;                   //dummy node to hang the merged list off
+    PCB *tail = &head;
+    while (a && b) {
+        if (a->number_of_lines <= b->number_of_lines) {
+            tail->next = a;
+            a = a->next;
+        } else {
+            tail->next = b;
+            b = b->next;
+        }
+        tail = tail->next;
+    }
+    tail->next = a ? a : b;     //whatever is left is already sorted
+    return head.next;
+}
+
+//stable merge sort of the list starting at head
+static PCB *sort_by_length(PCB *head) {
+    if (!head || !head->next) {
+        return head;
+    }
+    //split in half: slow moves one node for every two fast moves
+    PCB *slow = head, *fast = head->next;
+    while (fast && fast->next) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    PCB *second = slow->next;
+    slow->next = NULL;
+    return merge_by_length(sort_by_length(head), sort_by_length(second));
+}
+
+//reorder the queue by number of lines, shortest first
+//a merge sort instead of swapping neighbours, so it stays fast with very large queues
+void sort_queue_by_length(ReadyQueue *queue) {
+    queue->head = sort_by_length(queue->head);
+    queue->tail = queue->head;
+    while (queue->tail && queue->tail->next) {  //find the new tail
+        queue->tail = queue->tail->next;
+    }
+}
+
+//lower pass first, pid breaks ties so equal shares take turns in a fixed order.
+//Under EDF the earliest deadline goes first and PCBs without one go last, in pid order.
+//Under AUTO's SJF the batch script goes first, then the fewest lines left, in pid order.
+//Under SJF and AGING the lowest score with aging applied goes first, in heap_order. A PCB that
+//joined with a score of 0 can't age any further and goes first, like enqueueAGING puts it at the head.
+int heap_runs_before(ReadyQueue *queue, PCB *a, PCB *b) {
+    if (queue->by_score) {      //every other queued score is off by the same queue->aged, see queued_score
+        long score_a = a->job_length_score ? a->job_length_score + a->aged_at : 0;
+        long score_b = b->job_length_score ? b->job_length_score + b->aged_at : 0;
+        return score_a < score_b || (score_a == score_b && a->heap_order < b->heap_order);
+    }
+    if (queue->by_length) {
+        if (a->is_batch_script != b->is_batch_script) {
+            return a->is_batch_script;
+        }
+        int left_a = a->number_of_lines - a->pc, left_b = b->number_of_lines - b->pc;
+        return left_a < left_b || (left_a == left_b && a->pid < b->pid);
+    }
+    if (queue->by_deadline) {
+        uint64_t deadline_a = a->deadline ? a->deadline : UINT64_MAX;
+        uint64_t deadline_b = b->deadline ? b->deadline : UINT64_MAX;
+        return deadline_a < deadline_b || (deadline_a == deadline_b && a->pid < b->pid);
+    }
+    return a->pass < b->pass || (a->pass == b->pass && a->pid < b->pid);
+}
+
+//binary heap, sift the new PCB up from the bottom
+void heap_push(ReadyQueue *queue, PCB *pcb) {
+    if (queue->heap_size == queue->heap_capacity) {
+        queue->heap_capacity = queue->heap_capacity ? queue->heap_capacity * 2 : 16;
+        queue->heap = realloc(queue->heap, queue->heap_capacity * sizeof(PCB *));
+    }
+    int i = queue->heap_size++;
+    while (i > 0 && heap_runs_before(queue, pcb, queue->heap[(i - 1) / 2])) {
+        queue->heap[i] = queue->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    queue->heap[i] = pcb;
+    pcb->next = NULL;
+    count_in(queue, pcb);
+}
+
+//take the root, move the last PCB there and sift it down
+PCB *heap_pop(ReadyQueue *queue) {
+    if (queue->heap_size == 0) {
+        return NULL;
+    }
+    PCB *top = queue->heap[0];
+    PCB *last = queue->heap[--queue->heap_size];
+    int i = 0;
+    while (2 * i + 1 < queue->heap_size) {
+        int child = 2 * i + 1;
+        if (child + 1 < queue->heap_size && heap_runs_before(queue, queue->heap[child + 1], queue->heap[child])) {
+            child++;
+        }
+        if (!heap_runs_before(queue, queue->heap[child], last)) {
+            break;
+        }
+        queue->heap[i] = queue->heap[child];
+        i = child;
+    }
+    queue->heap[i] = last;
+    count_out(queue, top);
+    return top;
+}
+
+//a PCB joining the heap goes in front of the ones already there with the same score, like
+//enqueueAGING puts it in front of the first PCB with a score that isn't lower
+void score_push(ReadyQueue *queue, PCB *pcb) {
+    pcb->aged_at = queue->aged; //it hasn't aged in this queue yet
+    pcb->heap_order = --queue->next_order;
+    heap_push(queue, pcb);
+}
+
+PCB *score_pop(ReadyQueue *queue) {
+    PCB *pcb = heap_pop(queue);
+    pcb->job_length_score = queued_score(queue, pcb);   //apply the aging it got while waiting
+    return pcb;
+}
+
+//add tickets to a slot and every node of the Fenwick tree that covers it
+static void add_tickets(ReadyQueue *queue, int slot, long tickets) {
+    for (int node = slot + 1; node <= queue->slot_capacity; node += node & -node) {
+        queue->ticket_tree[node] += tickets;
+    }
+    queue->ticket_total += tickets;
+}
+
+//move the PCBs still in slots to the front, into twice as many slots as they need, and build
+//the tree over them again in O(n)
+static void compact_slots(ReadyQueue *queue) {
+    int live = 0;
+    for (int slot = 0; slot < queue->slot_count; slot++) {
+        if (queue->slots[slot]) {
+            queue->slots[live] = queue->slots[slot];
+            queue->slots[live]->slot = live;
+            live++;
+        }
+    }
+    if (queue->slot_capacity == 0 || 2 * live > queue->slot_capacity) {
+        queue->slot_capacity = live ? 2 * live : 16;
+        queue->slots = realloc(queue->slots, queue->slot_capacity * sizeof(PCB *));
+    }
+    free(queue->ticket_tree);
+    queue->ticket_tree = calloc(queue->slot_capacity + 1, sizeof(long));
+    for (int node = 1; node <= queue->slot_capacity; node++) {
+        if (node <= live) {
+            queue->ticket_tree[node] += queue->slots[node - 1]->tickets;
+        }
+        int parent = node + (node & -node);
+        if (parent <= queue->slot_capacity) {
+            queue->ticket_tree[parent] += queue->ticket_tree[node];
+        }
+    }
+    queue->slot_count = live;
+}
+
+//the tickets of a PCB that joins come after everyone else's, like taking the back of the list
+void ticket_push(ReadyQueue *queue, PCB *pcb) {
+    if (queue->slot_count == queue->slot_capacity) {
+        compact_slots(queue);
+    }
+    pcb->slot = queue->slot_count++;
+    queue->slots[pcb->slot] = pcb;
+    add_tickets(queue, pcb->slot, pcb->tickets);
+    pcb->next = NULL;
+    count_in(queue, pcb);
+}
+
+void ticket_drain(ReadyQueue *queue) {
+    for (int slot = 0; slot < queue->slot_count; slot++) {
+        PCB *pcb = queue->slots[slot];
+        if (pcb) {
+            count_out(queue, pcb);
+            pcb->slot = -1;
+            enqueue(queue, pcb);
+        }
+    }
+    queue->slot_count = 0;
+    queue->ticket_total = 0;
+    if (queue->ticket_tree) {
+        memset(queue->ticket_tree, 0, (queue->slot_capacity + 1) * sizeof(long));
+    }
+}
+
+//every PCB holds a run of consecutive tickets in the order they joined: walk down the tree to the
+//first slot whose tickets, added to the ones before it, go past ticket
+PCB *take_ticket(ReadyQueue *queue, long ticket) {
+    int node = 0;
+    int step = 1;
+    while (step * 2 <= queue->slot_capacity) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (node + step <= queue->slot_capacity && queue->ticket_tree[node + step] <= ticket) {
+            node += step;
+            ticket -= queue->ticket_tree[node];
+        }
+    }
+    PCB *current = queue->slots[node];
+    queue->slots[node] = NULL;
+    add_tickets(queue, node, -current->tickets);
+    current->slot = -1;
+    count_out(queue, current);
+    return current;
+}
+
+//take the first PCB with the given job id out of the queue, wherever it is
+PCB *remove_job_pcb(ReadyQueue *queue, int job_id) {
+    PCB *prev = NULL;
+    for (PCB * current = queue->head; current; prev = current, current = current->next) {
+        if (current->job_id != job_id) {
+            continue;
+        }
+        if (prev) {             //unlink it from the PCB before it
+            prev->next = current->next;
+        } else {
+            queue->head = current->next;
+        }
+        if (queue->tail == current) {   //it was last
+            queue->tail = prev;
+        }
+        current->next = NULL;
+        count_out(queue, current);
+        return current;
+    }
+    return NULL;
+}
@@ -3,11 +3,42 @@
 
 #   include "pcb.h"
 
+//what AUTO knows about a queue it runs, see scheduler.h
+typedef struct AutoState {
+    int mode;                   //AUTO_* strategy it is using
+    int quantum;                //instructions per slice under AUTO_RR
+    int looks;                  //times it looked at the queue
+    int wanted;                 //other strategy the latest looks asked for
+    int held;                   //looks in a row that asked for it
+    int left;                   //instructions until it looks again
+    int ran;                    //instructions run since it last looked
+    int runs;                   //programs run commands started since it last looked
+    double blocking;            //run commands per instruction, averaged over the looks so far
+} AutoState;
+
 //ready queue struct
 typedef struct ReadyQueue {
     PCB *head;                  //pointer to 1st PCB in queue
     PCB *tail;                  //pointer to last PCB in queue
     int size;                   //number of PCBs in queue
+    long aged;                  //total aging applied to the queue so far, see age_queue
+    int sorted;                 //SJF or AGING already put the queue in order, so resuming them doesn't sort it again
+    PCB **heap;                 //min-heap on pass, STRIDE keeps its PCBs here instead of the list while it runs
+    int heap_size;
+    int heap_capacity;
+    long pass;                  //STRIDE virtual time: pass of the PCB that was dispatched last
+    int by_deadline;            //EDF is running, the heap is ordered by deadline instead of pass
+    int by_length;              //AUTO runs it as SJF, the heap is ordered by lines left instead of pass
+    int by_score;               //SJF or AGING is running, the heap is ordered by job length score with aging applied
+    long next_order;            //heap_order of the next PCB that joins the SJF or AGING heap, counts down
+    PCB **slots;                //LOTTERY keeps its PCBs here while it runs, in the order they joined, NULL once they left
+    long *ticket_tree;          //Fenwick tree over the tickets in slots, so a draw finds its PCB in O(log n)
+    int slot_count;             //slots used so far, slots past it are free
+    int slot_capacity;
+    long ticket_total;          //tickets of the PCBs in slots
+    long long lines_left;       //lines the queued PCBs (list and heap) have left, added up, for AUTO
+    long long lines_left_squares;       //and their squares, so AUTO gets the spread without walking the queue
+    AutoState automatic;        //AUTO's measurements and choices for this queue
 } ReadyQueue;
 
 ReadyQueue *create_queue();     //function that will create a new empty ready queue
@@ -17,5 +48,16 @@ PCB *dequeue(ReadyQueue * queue);       //function to remove a PCB from the head
 int is_empty(ReadyQueue * queue);       //functino to check if queue is empty
 void enqueueAGING(ReadyQueue * queue, PCB * pcb);       //function to insert PCB back into queue correctly
 void enqueueFront(ReadyQueue * queue, PCB * pcb);       //function for background mode, will insert batch script process at the front of queue
+int queued_score(ReadyQueue * queue, PCB * pcb);        //function to get a queued PCB's job length score with aging applied
+void sort_queue_by_length(ReadyQueue * queue);  //function to reorder queue from shortest to longest job, keeping arrival order for ties
+void heap_push(ReadyQueue * queue, PCB * pcb);  //function to add a PCB to the STRIDE, EDF or AUTO heap, O(log n)
+PCB *heap_pop(ReadyQueue * queue);      //function to take the PCB with the lowest pass (earliest deadline under EDF, fewest lines left under AUTO) out of the heap, O(log n)
+int heap_runs_before(ReadyQueue * queue, PCB * a, PCB * b);     //function to check whether a comes out of the heap before b
+void score_push(ReadyQueue * queue, PCB * pcb); //function to add a PCB to the SJF or AGING heap, in front of PCBs with the same score like enqueueAGING, O(log n)
+PCB *score_pop(ReadyQueue * queue);     //function to take the PCB with the lowest job length score out of the SJF or AGING heap, with its aging applied, O(log n)
+void ticket_push(ReadyQueue * queue, PCB * pcb);        //function to give a PCB the next slot in the LOTTERY ticket tree, O(log n) amortised
+void ticket_drain(ReadyQueue * queue);  //function to put the PCBs in the LOTTERY ticket tree back on the list, in the order they joined
+PCB *take_ticket(ReadyQueue * queue, long ticket);      //function to take out the PCB holding the given ticket, counting tickets in the order the PCBs joined, for LOTTERY, O(log n)
+PCB *remove_job_pcb(ReadyQueue * queue, int job_id);    //function to take the first PCB of a job out of the queue, NULL if it has none left
 
 #endif
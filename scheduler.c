@@ -1,28 +1,380 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "pcb.h"
 #include "readyqueue.h"
 #include "scheduler.h"
 #include "shellmemory.h"
 #include "shell.h"
+#include "stats.h"
+#include "admission.h"
+#include "paging.h"
+#include "metrics.h"
+#include "decisions.h"
+#include "quotas.h"
+#include "scopes.h"
 
 //Define global queue
 ReadyQueue *global_queue = NULL;
 
+//tunables, the simulator changes these to try out other settings
+int rr_time_slice = 2;
+int rr30_time_slice = 30;
+int aging_step = 1;
+int share_quantum = 2;
+uint64_t lottery_state = 1;
+
+//policy currently running, dispatch overhead is recorded under it
+static int active_policy = POLICY_FCFS;
+
+//names in the same order as the POLICY_* enum
+static const char *policy_names[POLICY_COUNT] =
+    { "FCFS", "SJF", "RR", "RR30", "AGING", "STRIDE", "LOTTERY", "EDF", "AUTO" };
+
+int policy_from_name(const char *name) {
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        if (strcmp(policy_names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;                  //not one of the policies we support
+}
+
+//POLICY or, for the proportional share policies, POLICY:TICKETS, or EDF:MILLISECONDS
+int policy_from_spec(const char *spec, int *tickets) {
+    char name[16];
+    const char *colon = strchr(spec, ':');
+    *tickets = DEFAULT_TICKETS; //what a spec that isn't one leaves, so callers never see garbage
+    if (!colon) {
+        int policy = policy_from_name(spec);
+        *tickets = policy == POLICY_EDF ? 0 : DEFAULT_TICKETS;
+        return policy;
+    }
+    if (colon - spec >= (long) sizeof(name)) {
+        return -1;
+    }
+    memcpy(name, spec, colon - spec);
+    name[colon - spec] = '\0';
+    int policy = policy_from_name(name);
+    char *end;
+    long count = strtol(colon + 1, &end, 10);
+    long most = policy == POLICY_EDF ? EDF_MAX_DEADLINE : STRIDE1;
+    if ((policy != POLICY_STRIDE && policy != POLICY_LOTTERY && policy != POLICY_EDF)
+        || *end != '\0' || count < 1 || count > most) {
+        return -1;
+    }
+    *tickets = (int) count;
+    return policy;
+}
+
+void apply_spec(PCB *pcb, int policy, int tickets) {
+    if (policy == POLICY_EDF) {
+        pcb_set_deadline(pcb, tickets);
+    } else {
+        pcb_set_tickets(pcb, tickets);
+    }
+}
+
+const char *policy_name(int policy) {
+    return policy_names[policy];
+}
+
+//run all processes in queue with the given policy
+void run_policy(ReadyQueue *queue, int policy) {
+    int outer_policy = active_policy;   //a line typed at a terminal may run another queue in the middle of this one
+    active_policy = policy;
+    if (policy == POLICY_FCFS) {
+        FCFS(queue);            //execute all processes in queue through FCFS
+    } else if (policy == POLICY_SJF) {
+        SJF(queue);             //execute all processes in queue through SJF
+    } else if (policy == POLICY_RR) {
+        RR(queue, rr_time_slice);       //execute all processes in queue through round robin
+    } else if (policy == POLICY_RR30) {
+        RR(queue, rr30_time_slice);     //execute all processes in queue through round robin, time slice = 30
+    } else if (policy == POLICY_AGING) {
+        AGING(queue);           //execute all processes in queue with SJF with job Aging
+    } else if (policy == POLICY_STRIDE) {
+        STRIDE(queue);          //execute all processes in queue in proportion to their tickets
+    } else if (policy == POLICY_LOTTERY) {
+        LOTTERY(queue);         //same, but by random draw
+    } else if (policy == POLICY_EDF) {
+        EDF(queue);             //execute all processes in queue by their deadlines
+    } else if (policy == POLICY_AUTO) {
+        AUTO(queue);            //execute all processes in queue however suits them best
+    }
+    active_policy = outer_policy;
+}
+
+int scheduler_policy() {
+    return active_policy;
+}
+
+//hooks for modes that need to see every instruction (the daemon), NULL for the plain shell
+void (*scheduler_tick_hook)(PCB * pcb) = NULL;
+void (*scheduler_exit_hook)(PCB * pcb) = NULL;
+void (*scheduler_instruction_hook)(PCB * pcb) = NULL;
+
+//set by a hook to stop the running policy after the current instruction, see scheduler.h
+int scheduler_yield = 0;
+
+PCB *scheduler_current = NULL;
+
+//run the instruction current->pc points at and advance the program counter
+static void run_instruction(PCB *current) {
+    if (scheduler_tick_hook) {
+        scheduler_tick_hook(current);
+    }
+    PCB *outer = scheduler_current;     //a typed line may run a whole other queue in the middle of this instruction
+    scheduler_current = current;
+    Scope *outer_scope = mem_scope;
+    mem_scope = current->scope; //a background job's lines see its own variables
+    uint64_t cpu_start = accounting_on ? quota_cpu_now() : 0;
+    if (scheduler_instruction_hook) {
+        scheduler_instruction_hook(current);    //simulated instruction, there is no line to parse
+    } else {
+        int line = fetch_line(current, current->pc);    //faults the page in if it isn't loaded
+        ProgramLine instruction;
+        strcpy(instruction, shell_program_memory.lines[line]);  //the frame may be evicted while the line runs, e.g. by a nested exec
+        mem_slot_hint = shell_program_memory.var_slot[line];    //variable this line uses, interned when it was loaded
+        parseInput(instruction);        //sends current instruction to parser
+        mem_slot_hint = -1;
+    }
+    scheduler_current = outer;
+    mem_scope = outer_scope;
+    current->pc++;              //increment program counter
+    current->usage.instructions++;
+    if (accounting_on) {
+        current->usage.cpu_ns += quota_cpu_now() - cpu_start;
+        if (quota_check(current)) {
+            current->pc = current->number_of_lines;     //over a quota that kills, its program is over
+        }
+    }
+    metrics_instructions[active_policy]++;
+    if (metrics_interval_ns) {
+        metrics_tick();
+    }
+}
+
+static void child_gone(PCB *parent);
+
+//a process with a deadline is done, its children included: count whether it made it
+static void account_deadline(PCB *pcb) {
+    uint64_t now = stats_now();
+    if (now <= pcb->deadline) {
+        metrics_counters[METRIC_DEADLINES_MET]++;
+        return;
+    }
+    metrics_counters[METRIC_DEADLINES_MISSED]++;
+    metrics_counters[METRIC_DEADLINE_LATENESS_US] += (now - pcb->deadline) / 1000;
+    stats_record(&stats_commands[STAT_DEADLINE_LATENESS], now - pcb->deadline);
+}
+
+//a process and all of its children are done, whoever counts processes hears about it now
+static void free_process(PCB *pcb) {
+    if (pcb->exited == EXITED_FINISHED && pcb->deadline) {
+        account_deadline(pcb);
+    }
+    if (pcb->exited == EXITED_FINISHED && scheduler_exit_hook) {
+        scheduler_exit_hook(pcb);
+    }
+    quota_finished(pcb);
+    PCB *parent = pcb->parent;
+    scope_release(pcb->scope);
+    free(pcb->page_table);
+    free(pcb);                  //free the PCB
+    if (parent) {
+        child_gone(parent);
+    }
+}
+
+//one of parent's children is gone
+static void child_gone(PCB *parent) {
+    if (--parent->children > 0) {
+        return;
+    }
+    if (parent->exited) {
+        free_process(parent);   //it was only kept for its children, or killed while it waited for them
+    } else if (parent->blocked) {
+        parent->blocked = 0;    //its exec or source returns, it carries on with its next line
+        enqueue_arrival(parent->wake_queue, parent, parent->wake_policy);
+    }
+}
+
+//a process's own program is over: its frames go now, the PCB once its children are done
+static void end_process(PCB *pcb, int how) {
+    log_decision(DECISION_FINISH, pcb, how);
+    pcb->exited = how;
+    release_pages(pcb);         //remove SCRIPT source code from shell memory
+    if (pcb->children == 0) {
+        free_process(pcb);
+    }
+    admission_run();            //the freed frames may let a waiting program in
+}
+
+//process finished, clean up after it
+static void finish_process(PCB *current) {
+    end_process(current, EXITED_FINISHED);
+}
+
+//process is thrown away before it finished, e.g. by kill
+void kill_process(PCB *pcb) {
+    end_process(pcb, EXITED_KILLED);
+}
+
+void drop_process(PCB *pcb) {
+    backing_close(pcb->backing);        //it never got any frames to give back
+    pcb->backing = NULL;
+    pcb->exited = EXITED_KILLED;
+    free_process(pcb);
+}
+
+void adopt_child(PCB *child) {
+    PCB *parent = scheduler_current;
+    if (!parent) {
+        return;
+    }
+    child->parent = parent;
+    child->job_id = parent->job_id;     //its work counts towards its parent's job
+    child->scope = parent->scope;       //and it sees the same variables
+    if (child->scope) {
+        scope_hold(child->scope);
+    }
+    parent->children++;
+}
+
+void block_on_children() {
+    if (scheduler_current && scheduler_current->children > 0) {
+        scheduler_current->blocked = 1;
+    }
+}
+
+//the instruction that just ran is an exec or source waiting for its children: the process
+//stays out of the queue until child_gone puts it back
+static void park(ReadyQueue *queue, PCB *pcb) {
+    log_decision(DECISION_BLOCK, pcb, 0);
+    pcb->wake_queue = queue;
+    pcb->wake_policy = active_policy;
+}
+
+//a PCB joining a STRIDE queue starts at the queue's virtual time, so it gets no credit for
+//time it wasn't there and can't monopolise the CPU catching up
+static void stride_join(ReadyQueue *queue, PCB *pcb) {
+    if (pcb->pass < queue->pass) {
+        pcb->pass = queue->pass;
+    }
+    heap_push(queue, pcb);
+}
+
+//log where pcb went back in the queue: its position in the list, its pass in the STRIDE heap,
+//or under EDF 0 if it is still the one to run next and 1 if not
+static void requeued(ReadyQueue *queue, PCB *pcb) {
+    if (!decisions_on) {
+        return;
+    }
+    long position = 0;
+    if (active_policy == POLICY_STRIDE) {
+        position = pcb->pass;
+    } else if (active_policy == POLICY_EDF || queue->by_length) {      //EDF, or AUTO running as SJF
+        position = queue->heap[0] != pcb;
+    } else if (queue->by_score) {       //SJF or AGING: behind the list, then whatever runs before it in the heap
+        position = queue->size - queue->heap_size;
+        for (int i = 0; i < queue->heap_size; i++) {
+            position += queue->heap[i] != pcb && heap_runs_before(queue, queue->heap[i], pcb);
+        }
+    } else if (active_policy == POLICY_LOTTERY) {       //it took the last slot in the ticket tree
+        position = queue->size - 1;
+    } else {
+        for (PCB * queued = queue->head; queued != pcb; queued = queued->next) {
+            position++;
+        }
+    }
+    log_decision(DECISION_REQUEUE, pcb, position);
+}
+
+//add a new PCB to a queue that may already be running under policy
+void enqueue_arrival(ReadyQueue *queue, PCB *pcb, int policy) {
+    if (queue->by_score) {      //SJF or AGING is running it from the heap
+        score_push(queue, pcb);
+    } else if (policy == POLICY_SJF || policy == POLICY_AGING) {
+        //both keep the queue sorted by job length score, which starts out as the number of lines
+        enqueueAGING(queue, pcb);
+    } else if (policy == POLICY_STRIDE) {
+        stride_join(queue, pcb);
+    } else if (policy == POLICY_EDF) {
+        queue->by_deadline = 1; //an earlier deadline than the running process's preempts it at the next instruction
+        heap_push(queue, pcb);
+    } else {
+        enqueue(queue, pcb);    //FCFS and RR just take it at the back
+    }
+}
+
+//record how long it took to get from the end of the last time slice to the start of the next one,
+//and whether the CPU moved to another process
+static void record_dispatch(PCB *current, uint64_t dispatch_start) {
+    static int last_pid = 0;    //pids aren't reused, unlike PCB addresses
+    stats_record(&stats_policies[active_policy], stats_now() - dispatch_start);
+    if (current->pid != last_pid) {
+        metrics_switches[active_policy]++;
+        last_pid = current->pid;
+    }
+    log_decision(DECISION_DISPATCH, current, current->pc);
+}
+
 //run all processes in queue using FCFS
 void FCFS(ReadyQueue *queue) {
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
     while (!is_empty(queue)) {  //runs until queue is empty
         PCB *current = dequeue(queue);  //gets next process in queue to execute
+        record_dispatch(current, dispatch_start);
 
-        while (current->pc < current->number_of_lines) {        //keep looping until all instructions of current process are accounted for
-            parseInput(shell_program_memory.lines[current->start_index + current->pc]); //sends current instruction to parser
-            current->pc++;      //increment program counter
+        while (current->pc < current->number_of_lines && !scheduler_yield && !current->blocked) {        //keep looping until all instructions of current process are accounted for
+            run_instruction(current);
         }
+        log_decision(DECISION_SLICE_END, current, current->pc);
+        if (current->blocked) { //the next process goes while its children run
+            park(queue, current);
+            if (scheduler_yield) {
+                return;
+            }
+        } else if (current->pc < current->number_of_lines) {    //asked to yield, it carries on from here next time
+            enqueueFront(queue, current);
+            requeued(queue, current);
+            return;
+        } else {
+            //Clean-up
+            finish_process(current);
+        }
+        dispatch_start = stats_now();
+    }
+}
+
+//SJF and AGING run from a heap on job length score, so a dispatch costs O(log n) however long the
+//queue is. The head of the sorted list stays there and goes first, it may be the batch script or
+//a process that yielded; the rest keep their order on ties
+static void score_heap_enter(ReadyQueue *queue) {
+    queue->by_score = 1;
+    queue->next_order = 0;
+    PCB *first = dequeue(queue);
+    if (!first) {
+        return;
+    }
+    for (long order = 0; queue->head; order++) {
+        PCB *pcb = dequeue(queue);      //with the aging it got while waiting
+        pcb->aged_at = queue->aged;
+        pcb->heap_order = order;
+        heap_push(queue, pcb);
+    }
+    enqueueFront(queue, first);
+}
 
-        //Clean-up
-        free_program_lines(current->start_index, current->number_of_lines);     //remove SCRIPT source code from shell memory
-        free(current);          //free the PCB
+//whatever is left goes back on the list in score order, where the rest of the shell can see it
+static void score_heap_leave(ReadyQueue *queue) {
+    while (queue->heap_size > 0) {
+        enqueue(queue, score_pop(queue));
     }
+    queue->by_score = 0;
+    queue->sorted = 1;          //resuming doesn't have to sort it again
 }
 
 //run all processes in queue using SJF
@@ -32,84 +384,87 @@ void SJF(ReadyQueue *queue) {
     if (is_empty(queue)) {      //if queue is empty
         return;
     }
-    //to account for batch script process PCBs
-    PCB *batch_pcb = NULL;      //declare a NULL PCB pointer
-    if (queue->head->is_batch_script) { //if the head of queue has batch script process priority flag set to true (1)
-        batch_pcb = queue->head;        //save it
-        queue->head = batch_pcb->next;  // temporarily remove it from the queue
-        batch_pcb->next = NULL; //detach from queue
-    }
-    //since we only have a max of 3 programs, I just implemented a quick bubble sort to reorder by shortest job length
-    int swapped;                //this will keep track of whether any nodes were swapped during a pass
-    //bubble sort will keep interating over the list until a full pass is made without swaps
-    do {
-        swapped = 0;            //currently, no swaps made
-        PCB *current = queue->head;     //we start at head of the queue
-        PCB *prev = NULL;       //will track node before current
-
-        while (current && current->next) {
-            PCB *next_node = current->next;     //compare current node with its next node
-            if (current->number_of_lines > next_node->number_of_lines) {        //if node after current node has shorter job length, we swap!
-                if (prev) {     //not at the head of the queue
-                    prev->next = next_node;     //if prev exists, link it to next_node beccause next_node will move in front of current
-                    //example 1: A-prev B-current C-next D-next_next, and we swap B and C
-                    //A.next points to C
-                } else {        //if at the head of the queue
-                    queue->head = next_node;
-                    //example 2: A-prev B-current C-next, and we swap A and B
-                    //head points to B
-                }
-                current->next = next_node->next;        //skip next_node, so current points to the node after next_node
-                next_node->next = current;      //complete the swap, next_node now points to current
-                //example 1: B-current
-                //B.next = D
-                //C.next = B
-                //A -> C -> B -> D
-
-                //example 2: A-current
-                //current.next = C
-                //B.next = A
-                //B -> A -> C
-
-                swapped = 1;    //signal swap happens, so another pass is needed
-                prev = next_node;       //move prev to next_node because we need the node before new current for the next comparison
-            } else {            //no need to swap
-                prev = current; //so update previous node
-                current = current->next;        //move on to the next node
+    if (!queue->sorted) {       //a queue that yielded part way through is already in order
+        //to account for batch script process PCBs
+        PCB *batch_pcb = NULL;  //declare a NULL PCB pointer
+        if (queue->head->is_batch_script) {     //if the head of queue has batch script process priority flag set to true (1)
+            batch_pcb = queue->head;    //save it
+            queue->head = batch_pcb->next;      // temporarily remove it from the queue
+            batch_pcb->next = NULL;     //detach from queue
+        }
+        //stable merge sort by job length, ties keep their arrival order
+        sort_queue_by_length(queue);
+
+        //to account for batch script process PCBs
+        if (batch_pcb) {        //if there is a priority batch script process PCB
+            batch_pcb->next = queue->head;      //reattach back to queue
+            queue->head = batch_pcb;    //set batch PCB as head of queue
+            if (!queue->tail) { //it was the only PCB
+                queue->tail = batch_pcb;
             }
         }
-    } while (swapped);          //keep going until no swaps made in a pass
+        queue->sorted = 1;
+    }
+    //then run it like FCFS because both are non preemptive policies
+    score_heap_enter(queue);
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
+    while (!is_empty(queue)) {
+        PCB *current = queue->head ? dequeue(queue) : score_pop(queue);
+        record_dispatch(current, dispatch_start);
 
-    //to account for batch script process PCBs
-    if (batch_pcb) {            //if there is a priority batch script process PCB
-        batch_pcb->next = queue->head;  //reattach back to queue
-        queue->head = batch_pcb;        //set batch PCB as head of queue
+        while (current->pc < current->number_of_lines && !scheduler_yield && !current->blocked) {
+            run_instruction(current);
+        }
+        log_decision(DECISION_SLICE_END, current, current->pc);
+        if (current->blocked) { //the next process goes while its children run
+            park(queue, current);
+            if (scheduler_yield) {
+                break;
+            }
+        } else if (current->pc < current->number_of_lines) {    //asked to yield, it carries on from here next time
+            enqueueFront(queue, current);
+            requeued(queue, current);
+            break;
+        } else {
+            finish_process(current);
+        }
+        dispatch_start = stats_now();
     }
-    //then run FCFS because both are non preemptive policies
-    FCFS(queue);
+    score_heap_leave(queue);
 }
 
 //run all processes in queue with Round Robin policy
 void RR(ReadyQueue *queue, int time_slice) {
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
     while (!is_empty(queue)) {  //runs until queue is empty
         PCB *current = dequeue(queue);
+        record_dispatch(current, dispatch_start);
 
         int instructions_left_to_run = time_slice;      //define time slice
         //keep looping until all instructions of current process are accounted for, or timer is up (2 instructions executed)
         while (instructions_left_to_run > 0
-               && current->pc < current->number_of_lines) {
-            parseInput(shell_program_memory.lines[current->start_index + current->pc]); //sends current instruction to parser
-            current->pc++;      //increment program counter
+               && current->pc < current->number_of_lines && !scheduler_yield && !current->blocked) {
+            run_instruction(current);
             instructions_left_to_run--;
         }
+        log_decision(DECISION_SLICE_END, current, current->pc);
 
-        if (current->pc >= current->number_of_lines) {  //process finished!
+        if (current->blocked) { //waiting for its children
+            park(queue, current);
+        } else if (current->pc >= current->number_of_lines) {   //process finished!
             //Clean-up
-            free_program_lines(current->start_index, current->number_of_lines); //remove SCRIPT source code from shell memory
-            free(current);      //free the PCB
+            finish_process(current);
+        } else if (instructions_left_to_run > 0) {      //asked to yield part way through its slice, it goes first next time
+            enqueueFront(queue, current);
+            requeued(queue, current);
         } else {                //process not finished
             enqueue(queue, current);    //add it to back of queue
+            requeued(queue, current);
+        }
+        if (scheduler_yield) {
+            return;
         }
+        dispatch_start = stats_now();
     }
 }
 
@@ -119,90 +474,355 @@ void AGING(ReadyQueue *queue) {
     if (is_empty(queue)) {      //if queue is empty
         return;
     }
-    //to account for batch script process PCBs
-    PCB *batch_pcb = NULL;      //declare a NULL PCB pointer
-    if (queue->head->is_batch_script) { //if the head of queue has batch script process priority
-        batch_pcb = queue->head;        //save it
-        queue->head = batch_pcb->next;  // temporarily remove it from the queue
-        batch_pcb->next = NULL; //detach from queue
-    }
-    //since we only have a max of 3 programs, I just implemented a quick bubble sort to reorder by shortest job length
-    int swapped;                //this will keep track of whether any nodes were swapped during a pass
-    //bubble sort will keep interating over the list until a full pass is made without swaps
-    do {
-        swapped = 0;            //currently, no swaps made
-        PCB *current = queue->head;     //we start at head of the queue
-        PCB *prev = NULL;       //will track node before current
-
-        while (current && current->next) {
-            PCB *next_node = current->next;     //compare current node with its next node
-            if (current->number_of_lines > next_node->number_of_lines) {        //if node after current node has shorter job length, we swap!
-                if (prev) {     //not at the head of the queue
-                    prev->next = next_node;     //if prev exists, link it to next_node beccause next_node will move in front of current
-                    //example 1: A-prev B-current C-next D-next_next, and we swap B and C
-                    //A.next points to C
-                } else {        //if at the head of the queue
-                    queue->head = next_node;
-                    //example 2: A-prev B-current C-next, and we swap A and B
-                    //head points to B
-                }
-                current->next = next_node->next;        //skip next_node, so current points to the node after next_node
-                next_node->next = current;      //complete the swap, next_node now points to current
-                //example 1: B-current
-                //B.next = D
-                //C.next = B
-                //A -> C -> B -> D
-
-                //example 2: A-current
-                //current.next = C
-                //B.next = A
-                //B -> A -> C
-
-                swapped = 1;    //signal swap happens, so another pass is needed
-                prev = next_node;       //move prev to next_node because we need the node before new current for the next comparison
-            } else {            //no need to swap
-                prev = current; //so update previous node
-                current = current->next;        //move on to the next node
-            }
+    if (!queue->sorted) {       //a queue that yielded part way through is already in order
+        //to account for batch script process PCBs
+        PCB *batch_pcb = NULL;  //declare a NULL PCB pointer
+        if (queue->head->is_batch_script) {     //if the head of queue has batch script process priority flag set to true (1)
+            batch_pcb = queue->head;    //save it
+            queue->head = batch_pcb->next;      // temporarily remove it from the queue
+            batch_pcb->next = NULL;     //detach from queue
         }
-    } while (swapped);          //keep going until no swaps made in a pass
+        //stable merge sort by job length, ties keep their arrival order
+        sort_queue_by_length(queue);
 
-    //to account for batch script process PCBs
-    if (batch_pcb) {            //if there is a priority batch script process PCB
-        batch_pcb->next = queue->head;  //reattach back to queue
-        queue->head = batch_pcb;        //set batch PCB as head of queue
+        //to account for batch script process PCBs
+        if (batch_pcb) {        //if there is a priority batch script process PCB
+            batch_pcb->next = queue->head;      //reattach back to queue
+            queue->head = batch_pcb;    //set batch PCB as head of queue
+            if (!queue->tail) { //it was the only PCB
+                queue->tail = batch_pcb;
+            }
+        }
+        queue->sorted = 1;
     }
     //now we start on the SJF with Aging
+    score_heap_enter(queue);
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
     while (!is_empty(queue)) {  //runs until queue is empty
-        PCB *current = dequeue(queue);  //takes head process
+        PCB *current = queue->head ? dequeue(queue) : score_pop(queue); //takes the process with the lowest score
+        record_dispatch(current, dispatch_start);
 
         if (current->pc < current->number_of_lines) {   //if instructions haven't been execute, enter if statement
-            parseInput(shell_program_memory.lines[current->start_index + current->pc]); //sends current instruction to parser
-            current->pc++;      //increment program counter
+            run_instruction(current);
         }
+        log_decision(DECISION_SLICE_END, current, current->pc);
 
+        dispatch_start = stats_now();   //aging and reinsertion count as scheduling overhead
         if (!is_empty(queue)) { //if queue is not empty
             age_queue(queue);   //age all other processes in queue
         }
 
 
-        if (current->pc >= current->number_of_lines) {  //process finished!
+        if (current->blocked) { //waiting for its children
+            park(queue, current);
+        } else if (current->pc >= current->number_of_lines) {   //process finished!
             //Clean-up
-            free_program_lines(current->start_index, current->number_of_lines); //remove SCRIPT source code from shell memory
-            free(current);      //free the PCB
+            finish_process(current);
         } else {                //process not finished
-            enqueueAGING(queue, current);       //reinsert dequeued PCB correctly
+            score_push(queue, current); //reinsert dequeued PCB correctly
+            requeued(queue, current);
+        }
+        if (scheduler_yield) {
+            break;
         }
     }
+    score_heap_leave(queue);
 }
 
-//After each instruction, all jobs in the queue get aged
-void age_queue(ReadyQueue *queue) {
-    PCB *current = queue->head; //get the head of queue
-    while (current) {           //while loop keeps going until we reach end of the loop
-        if (current->job_length_score > 0) {    //if job length score is greater than 0
-            current->job_length_score--;        //decreament job length score
+//run all processes in queue with stride scheduling: the PCB with the lowest pass runs for
+//share_quantum instructions, then its pass moves on by its stride for every instruction it ran
+void STRIDE(ReadyQueue *queue) {
+    while (queue->head) {       //PCBs that were enqueued the ordinary way move into the heap
+        stride_join(queue, dequeue(queue));
+    }
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
+    while (!is_empty(queue)) {
+        PCB *current = heap_pop(queue);
+        record_dispatch(current, dispatch_start);
+        queue->pass = current->pass;    //virtual time is the lowest pass in the queue
+
+        int ran = 0;
+        while (ran < share_quantum && current->pc < current->number_of_lines && !scheduler_yield && !current->blocked) {
+            run_instruction(current);
+            ran++;
+        }
+        current->pass += current->stride * ran;
+        log_decision(DECISION_SLICE_END, current, current->pc);
+
+        dispatch_start = stats_now();   //reinsertion counts as scheduling overhead
+        if (current->blocked) { //waiting for its children
+            park(queue, current);
+        } else if (current->pc >= current->number_of_lines) {   //process finished!
+            finish_process(current);
+        } else {
+            heap_push(queue, current);
+            requeued(queue, current);
+        }
+        if (scheduler_yield) {
+            break;
+        }
+    }
+    //whatever is left goes back on the list in pass order, where the rest of the shell can see it
+    while (queue->heap_size > 0) {
+        enqueue(queue, heap_pop(queue));
+    }
+}
+
+//xorshift64, the seed makes lottery runs repeatable
+static uint64_t draw() {
+    lottery_state ^= lottery_state << 13;
+    lottery_state ^= lottery_state >> 7;
+    lottery_state ^= lottery_state << 17;
+    return lottery_state;
+}
+
+//run all processes in queue with lottery scheduling: every quantum goes to a random ticket,
+//so each PCB's share is its tickets over the total, on average
+//the PCBs hold their tickets in a Fenwick tree while it runs, so a draw costs O(log n), see take_ticket
+void LOTTERY(ReadyQueue *queue) {
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
+    while (!is_empty(queue)) {
+        while (queue->head) {   //PCBs that were enqueued the ordinary way take the next slots
+            ticket_push(queue, dequeue(queue));
+        }
+        PCB *current = take_ticket(queue, (long) (draw() % (uint64_t) queue->ticket_total));
+        record_dispatch(current, dispatch_start);
+
+        int ran = 0;
+        while (ran < share_quantum && current->pc < current->number_of_lines && !scheduler_yield && !current->blocked) {
+            run_instruction(current);
+            ran++;
+        }
+        log_decision(DECISION_SLICE_END, current, current->pc);
+
+        if (current->blocked) { //waiting for its children
+            park(queue, current);
+        } else if (current->pc >= current->number_of_lines) {   //process finished!
+            finish_process(current);
+        } else {
+            while (queue->head) {       //like on the list, it goes behind what arrived while it ran
+                ticket_push(queue, dequeue(queue));
+            }
+            ticket_push(queue, current);
+            requeued(queue, current);
+        }
+        if (scheduler_yield) {
+            break;
+        }
+        dispatch_start = stats_now();
+    }
+    ticket_drain(queue);        //whatever is left goes back on the list, where the rest of the shell can see it
+}
+
+//run all processes in queue earliest deadline first: the PCB at the top of the deadline heap runs
+//until it is done, blocks, or a PCB with an earlier deadline shows up (a nested exec, a child
+//that finished and woke its parent, a program that got through admission)
+void EDF(ReadyQueue *queue) {
+    queue->by_deadline = 1;
+    while (queue->head) {       //PCBs that were enqueued the ordinary way move into the heap
+        heap_push(queue, dequeue(queue));
+    }
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
+    while (!is_empty(queue)) {
+        PCB *current = heap_pop(queue);
+        record_dispatch(current, dispatch_start);
+
+        while (current->pc < current->number_of_lines && !scheduler_yield && !current->blocked
+               && !(queue->heap_size > 0 && heap_runs_before(queue, queue->heap[0], current))) {
+            run_instruction(current);
         }
-        current = current->next;        //move on to the next node in the queue
+        log_decision(DECISION_SLICE_END, current, current->pc);
+
+        dispatch_start = stats_now();   //reinsertion counts as scheduling overhead
+        if (current->blocked) { //waiting for its children
+            park(queue, current);
+        } else if (current->pc >= current->number_of_lines) {   //process finished!
+            finish_process(current);
+        } else {                //preempted, or asked to yield
+            heap_push(queue, current);
+            requeued(queue, current);
+        }
+        if (scheduler_yield) {
+            break;
+        }
+    }
+    //whatever is left goes back on the list in deadline order, where the rest of the shell can see it
+    while (queue->heap_size > 0) {
+        enqueue(queue, heap_pop(queue));
+    }
+    queue->by_deadline = 0;
+}
+
+//an AUTO decision, for the auto command
+typedef struct AutoDecision {
+    uint64_t time;              //stats_now() when it was made
+    int depth;                  //processes waiting in the queue
+    double spread;              //coefficient of variation of their lines left
+    double blocking;            //run commands per instruction since the look before
+    int from, to;               //AUTO_* strategy before and after
+    int quantum;                //AUTO_RR quantum after
+    const char *why;
+} AutoDecision;
+
+static const char *auto_mode_names[AUTO_MODE_COUNT] = { "FCFS", "SJF", "RR" };
+static AutoDecision auto_log[AUTO_LOG_SIZE];    //ring of the latest changes and held back switches
+static long auto_logged = 0;    //decisions that went into it so far
+static long auto_looks = 0;
+
+static void auto_note(AutoState *state, int depth, double spread, double blocking, int from, const char *why) {
+    AutoDecision *decision = &auto_log[auto_logged++ % AUTO_LOG_SIZE];
+    decision->time = stats_now();
+    decision->depth = depth;
+    decision->spread = spread;
+    decision->blocking = blocking;
+    decision->from = from;
+    decision->to = state->mode;
+    decision->quantum = state->quantum;
+    decision->why = why;
+}
+
+//measure the queue and pick the strategy and quantum for the next AUTO_LOOK_EVERY instructions
+static void auto_look(ReadyQueue *queue) {
+    AutoState *state = &queue->automatic;
+    int depth = queue->size;
+    double mean = depth ? (double) queue->lines_left / depth : 0;       //the queue keeps the totals, see readyqueue.h
+    double variance = depth ? (double) queue->lines_left_squares / depth - mean * mean : 0;
+    double spread = mean > 0 && variance > 0 ? sqrt(variance) / mean : 0;
+    double recent = state->ran ? (double) state->runs / state->ran : 0;
+    double blocking = state->looks ? (state->blocking + recent) / 2 : recent;      //runs rarely line up with the looks
+    state->blocking = blocking;
+
+    int target = state->mode;   //with one process or none there is nothing to choose
+    if (depth > 1) {
+        if (blocking >= (state->mode == AUTO_RR ? AUTO_BLOCKING_LOW : AUTO_BLOCKING_HIGH)) {
+            target = AUTO_RR;
+        } else if (spread >= (state->mode == AUTO_SJF ? AUTO_SPREAD_LOW : AUTO_SPREAD_HIGH)) {
+            target = AUTO_SJF;
+        } else {
+            target = AUTO_FCFS;
+        }
+    }
+    const char *why = target == AUTO_RR ? "programs run often" : target == AUTO_SJF ? "lengths spread out" : "lengths alike";
+
+    int from = state->mode;
+    if (state->looks++ == 0) {  //nothing to hold on to yet
+        state->mode = target;
+        state->quantum = rr_time_slice;
+        auto_note(state, depth, spread, blocking, from, why);
+    } else if (target != state->mode) {
+        state->held = target == state->wanted ? state->held + 1 : 1;
+        state->wanted = target;
+        if (state->held >= AUTO_HOLD) {
+            state->mode = target;
+            state->held = 0;
+            metrics_counters[METRIC_AUTO_SWITCHES]++;
+        }
+        auto_note(state, depth, spread, blocking, from, state->mode == target ? why : "held back, too soon");
+    } else {
+        state->held = 0;
     }
+
+    //a slice ends about where a process would block anyway
+    if (state->mode == AUTO_RR && blocking > 0) {
+        int quantum = (int) (1 / blocking + 0.5);
+        quantum = quantum < 1 ? 1 : quantum > rr30_time_slice ? rr30_time_slice : quantum;
+        if (2 * abs(quantum - state->quantum) > state->quantum) {
+            state->quantum = quantum;
+            auto_note(state, depth, spread, blocking, from, "quantum retuned");
+        }
+    }
+
+    auto_looks++;
+    log_decision(DECISION_AUTO, NULL, state->mode * 256 + state->quantum);
+    state->left = AUTO_LOOK_EVERY;
+    state->ran = state->runs = 0;
+}
+
+//AUTO_SJF is over: whatever is in the heap goes back on the list, shortest first, where FCFS,
+//RR and the rest of the shell see it
+static void auto_leave_heap(ReadyQueue *queue) {
+    while (queue->heap_size > 0) {
+        enqueue(queue, heap_pop(queue));
+    }
+    queue->by_length = 0;
+}
+
+//run all processes in queue with whichever strategy auto_look picked last, looking again every AUTO_LOOK_EVERY instructions
+void AUTO(ReadyQueue *queue) {
+    AutoState *state = &queue->automatic;
+    uint64_t dispatch_start = stats_now();      //scheduling overhead is timed from here until the next instruction runs
+    while (!is_empty(queue)) {
+        if (state->left <= 0) {
+            auto_look(queue);
+        }
+        PCB *current;
+        if (state->mode == AUTO_SJF) {  //from a heap on lines left, so SJF costs O(log n) per dispatch like STRIDE
+            queue->by_length = 1;
+            while (queue->head) {       //PCBs that were enqueued the ordinary way move into the heap
+                heap_push(queue, dequeue(queue));
+            }
+            current = heap_pop(queue);
+        } else {
+            auto_leave_heap(queue);
+            current = dequeue(queue);
+        }
+        record_dispatch(current, dispatch_start);
+
+        int slice = state->mode == AUTO_RR && state->quantum < state->left ? state->quantum : state->left;
+        int runs = current->usage.runs;
+        int ran = 0;
+        while (ran < slice && current->pc < current->number_of_lines && !scheduler_yield && !current->blocked) {
+            run_instruction(current);
+            ran++;
+        }
+        state->left -= ran;
+        state->ran += ran;
+        state->runs += current->usage.runs - runs;
+        log_decision(DECISION_SLICE_END, current, current->pc);
+
+        dispatch_start = stats_now();   //reinsertion counts as scheduling overhead
+        if (current->blocked) { //waiting for its children
+            park(queue, current);
+        } else if (current->pc >= current->number_of_lines) {   //process finished!
+            finish_process(current);
+        } else if (state->mode == AUTO_SJF) {
+            heap_push(queue, current);  //carries on unless something shorter came
+            requeued(queue, current);
+        } else if (state->mode == AUTO_RR && ran >= state->quantum) {
+            enqueue(queue, current);    //its slice is over
+            requeued(queue, current);
+        } else {                //FCFS carries on with it after the look
+            enqueueFront(queue, current);
+            requeued(queue, current);
+        }
+        if (scheduler_yield) {
+            break;
+        }
+    }
+    auto_leave_heap(queue);
+}
+
+void auto_print() {
+    printf("looks %ld, switches %llu\n", auto_looks, (unsigned long long) metrics_counters[METRIC_AUTO_SWITCHES]);
+    if (auto_logged == 0) {
+        return;
+    }
+    printf("%-12s %5s %7s %9s %-13s %7s  %s\n", "time", "depth", "spread", "blocking", "strategy", "quantum", "why");
+    uint64_t now = stats_now();
+    long first = auto_logged > AUTO_LOG_SIZE ? auto_logged - AUTO_LOG_SIZE : 0;
+    for (long i = first; i < auto_logged; i++) {
+        AutoDecision *decision = &auto_log[i % AUTO_LOG_SIZE];
+        char ago[24], strategy[24];
+        snprintf(ago, sizeof(ago), "-%.1fms", (now - decision->time) / 1000000.0);
+        snprintf(strategy, sizeof(strategy), "%s->%s", auto_mode_names[decision->from], auto_mode_names[decision->to]);
+        printf("%-12s %5d %7.2f %9.2f %-13s %7d  %s\n", ago, decision->depth, decision->spread, decision->blocking,
+               strategy, decision->quantum, decision->why);
+    }
+}
+
+//After each instruction, all jobs in the queue get aged
+//every waiting job loses aging_step, which queued_score applies lazily, so this is O(1)
+void age_queue(ReadyQueue *queue) {
+    queue->aged += aging_step;
+    log_decision(DECISION_AGE, NULL, queue->aged);
 }
@@ -1,25 +1,132 @@
 #ifndef SCHEDULER_H
 #   define SCHEDULER_H
 
+#   include <stdint.h>
 #   include "pcb.h"
 #   include "readyqueue.h"
 
 extern ReadyQueue *global_queue;        //Declare a global ready queue, that'll be in scheduler.h
 
+//scheduling policies that exec accepts
+enum {
+    POLICY_FCFS,
+    POLICY_SJF,
+    POLICY_RR,
+    POLICY_RR30,
+    POLICY_AGING,
+    POLICY_STRIDE,              //proportional share by tickets, deterministic
+    POLICY_LOTTERY,             //proportional share by tickets, random draws
+    POLICY_EDF,                 //earliest deadline first, preemptive
+    POLICY_AUTO,                //picks one of the strategies below from what it sees in the queue
+    POLICY_COUNT
+};
+
+int policy_from_name(const char *name); //returns the POLICY_* value for a policy name, or -1 if it isn't a valid policy
+int policy_from_spec(const char *spec, int *tickets);   //like policy_from_name, but also takes STRIDE:TICKETS and LOTTERY:TICKETS (tickets default to DEFAULT_TICKETS), and EDF:MILLISECONDS, whose deadline goes in tickets (0 without one)
+void apply_spec(PCB * pcb, int policy, int tickets);    //give pcb what policy_from_spec found: its tickets, or its deadline under EDF
+const char *policy_name(int policy);    //returns the name exec uses for a POLICY_* value
+
+//function that will run all processes in the given queue using the given POLICY_* policy
+void run_policy(ReadyQueue * queue, int policy);
+
+//function that will add a new PCB to a queue that may already be running under the given policy
+void enqueue_arrival(ReadyQueue * queue, PCB * pcb, int policy);
+
+//optional hooks, called before every instruction and when a process finishes (before its PCB is freed)
+extern void (*scheduler_tick_hook)(PCB * pcb);
+extern void (*scheduler_exit_hook)(PCB * pcb);
+//optional hook that replaces running the instruction through the parser, for the simulator
+extern void (*scheduler_instruction_hook)(PCB * pcb);
+
+//a hook sets this to make run_policy return after the current instruction. Every unfinished PCB
+//stays in the queue in policy order, so calling run_policy again on it resumes where it stopped.
+//Whoever set it clears it.
+extern int scheduler_yield;
+
+//free a PCB that is being thrown away before it finished, it must not be in a queue
+void kill_process(PCB * pcb);
+//free a PCB that never got frames, e.g. one cancelled while it waited for admission
+void drop_process(PCB * pcb);
+
+//Nested exec and source: a script line that runs exec or source doesn't start a policy loop of
+//its own. The new PCBs join the queue that is running, under its policy, as children of the
+//process running the line (adopt_child). Unless exec was given &, that process then waits
+//(block_on_children): it leaves the queue after the line and rejoins it when its last child
+//finishes, so its next line runs after them, like before. A process whose program ends while
+//children are still running keeps its PCB until they are done, and the exit hook only hears
+//about it then, so jobs count their whole tree of processes.
+extern PCB *scheduler_current;  //process whose instruction is running, NULL between instructions
+int scheduler_policy();         //POLICY_* of the queue being run
+void adopt_child(PCB * child);  //make child a child of scheduler_current, in its job
+void block_on_children();       //scheduler_current waits for its children after its current instruction
+
+//tunables, defaults match the assignment spec
+extern int rr_time_slice;       //instructions per time slice under RR, 2
+extern int rr30_time_slice;     //instructions per time slice under RR30, 30
+extern int aging_step;          //how much every waiting job's score drops per instruction under AGING, 1
+extern int share_quantum;       //instructions a PCB runs per dispatch under STRIDE and LOTTERY, 2
+extern uint64_t lottery_state;  //LOTTERY random state, set it to seed the draws
+
 //function that will run all process in the given queue using FCFS
 void FCFS(ReadyQueue * queue);
 
 //function that will run all processes in the given queue using SJF
-//we reorder queue having shortest job length pcb go first, and longest job length pcb go last, then call FCFS function
+//we reorder queue having shortest job length pcb go first, and longest job length pcb go last, then run it like FCFS
+//from a heap on job length score, O(log n) per dispatch
 void SJF(ReadyQueue * queue);
 
 //function that will run all processes in the given queue using RR
 void RR(ReadyQueue * queue, int time_slice);
 
-//function that will run all processes in the given queue using SJF with job aging
+//function that will run all processes in the given queue using SJF with job aging, O(log n) per instruction
 void AGING(ReadyQueue * queue);
 
+//function that will run all processes in the given queue using stride scheduling, O(log n) per dispatch
+void STRIDE(ReadyQueue * queue);
+
+//function that will run all processes in the given queue using lottery scheduling, O(log n) per draw
+void LOTTERY(ReadyQueue * queue);
+
+//function that will run all processes in the given queue earliest deadline first, O(log n) per dispatch.
+//A process is preempted at the next instruction boundary when one with an earlier deadline arrives.
+//Processes without a deadline run after all those with one, in arrival order. Every process that
+//had a deadline is counted as met or missed when it finishes, with how late it was, see metrics.
+void EDF(ReadyQueue * queue);
+
+//AUTO: the strategies it switches between
+enum {
+    AUTO_FCFS,                  //run the process at the head until it is done
+    AUTO_SJF,                   //run the process with the fewest lines left, shortest remaining first
+    AUTO_RR,                    //round robin with a quantum it tunes
+    AUTO_MODE_COUNT
+};
+
+#   define AUTO_LOOK_EVERY 10   //instructions between looks at the queue
+#   define AUTO_HOLD 2          //looks in a row that must ask for another strategy before it switches
+#   define AUTO_SPREAD_HIGH 0.5 //coefficient of variation of lines left that switches to AUTO_SJF
+#   define AUTO_SPREAD_LOW 0.3  //and that switches back from it
+#   define AUTO_BLOCKING_HIGH 0.25      //run commands per instruction that switch to AUTO_RR
+#   define AUTO_BLOCKING_LOW 0.15       //and back from it
+#   define AUTO_LOG_SIZE 32     //decisions the auto command shows
+
+//function that will run all processes in the given queue, choosing how as it goes. Every
+//AUTO_LOOK_EVERY instructions it measures the queue depth, how spread out the lines left are
+//(their coefficient of variation) and how often lines started a program with run (blocking,
+//the shell waits for each one, averaged with halving weights over the looks). Lines say little
+//about time when they wait on programs, so frequent blocking asks for AUTO_RR, with the quantum
+//set to the instructions between run commands so a slice ends about where a process would
+//block. Otherwise a wide
+//spread asks for AUTO_SJF, which is best for turnaround, and alike lengths for AUTO_FCFS, which
+//is as good and switches less. Thresholds have a gap between entering and leaving a strategy,
+//a switch needs AUTO_HOLD looks in a row, and the quantum only changes when it is off by more
+//than half. Decisions are counted in metrics, go into the decision log as DECISION_AUTO and the
+//latest changes are kept for the auto command. It only looks at lines and run counts, never at
+//the clock, so a replayed run decides the same. A look costs O(1), the queue keeps running totals
+//of lines left, and AUTO_SJF dispatches from a heap on lines left, like STRIDE and EDF do.
+void AUTO(ReadyQueue * queue);
+void auto_print();              //print the latest strategy changes AUTO made, with what it measured
+
 //helper function for AGING
-void age_queue(ReadyQueue * queue);     //function that will decrease a job's "job length score" by 1
+void age_queue(ReadyQueue * queue);     //function that will decrease every waiting job's "job length score" by aging_step
 
 #endif
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "scopes.h"
+#include "shellmemory.h"
+
+#define BITS 5                  //hash bits used per level
+#define WIDTH (1 << BITS)       //children a branch can have
+
+enum { NODE_LEAF, NODE_BRANCH, NODE_COLLISION };
+
+//a node is never changed once another node or scope can see it, a new version copies it instead
+struct ScopeNode {
+    int references;             //parents and scope roots holding it
+    int kind;                   //NODE_*
+    uint32_t hash;              //leaf and collision: hash_name of the name(s) under it
+    char *name;                 //leaf
+    char *value;                //leaf
+    uint32_t bitmap;            //branch: which of the WIDTH slots have a child
+    int count;                  //children
+    ScopeNode *children[];      //branch: one per bit set in bitmap, in bit order. collision: leaves with the same hash
+};
+
+static ScopeNode *global_root = NULL;   //the global variables, once mirrored is set
+static int mirrored = 0;        //a snapshot was taken, mem_set_slot keeps global_root up to date from then on
+
+static ScopeNode *new_node(int kind, int count) {
+    ScopeNode *node = malloc(sizeof(ScopeNode) + count * sizeof(ScopeNode *));
+    node->references = 1;
+    node->kind = kind;
+    node->hash = 0;
+    node->name = node->value = NULL;
+    node->bitmap = 0;
+    node->count = count;
+    return node;
+}
+
+static ScopeNode *hold(ScopeNode *node) {
+    if (node) {
+        node->references++;
+    }
+    return node;
+}
+
+static void release(ScopeNode *node) {
+    if (!node || --node->references > 0) {
+        return;
+    }
+    for (int i = 0; i < node->count; i++) {
+        release(node->children[i]);
+    }
+    free(node->name);
+    free(node->value);
+    free(node);
+}
+
+static ScopeNode *new_leaf(const char *name, const char *value) {
+    ScopeNode *leaf = new_node(NODE_LEAF, 0);
+    leaf->hash = hash_name(name);
+    leaf->name = strdup(name);
+    leaf->value = strdup(value);
+    return leaf;
+}
+
+//a copy of a branch or collision node with room for extra children after the ones it shares
+static ScopeNode *copy_node(ScopeNode *node, int extra) {
+    ScopeNode *copy = new_node(node->kind, node->count + extra);
+    copy->hash = node->hash;
+    copy->bitmap = node->bitmap;
+    for (int i = 0; i < node->count; i++) {
+        copy->children[i] = hold(node->children[i]);
+    }
+    return copy;
+}
+
+//node is a leaf or collision with leaf's hash: a version with leaf instead of the one with its name, or added
+static ScopeNode *collide(ScopeNode *node, ScopeNode *leaf) {
+    if (node->kind == NODE_LEAF) {
+        if (strcmp(node->name, leaf->name) == 0) {
+            return leaf;
+        }
+        ScopeNode *bucket = new_node(NODE_COLLISION, 2);
+        bucket->hash = leaf->hash;
+        bucket->children[0] = hold(node);
+        bucket->children[1] = leaf;
+        return bucket;
+    }
+    for (int i = 0; i < node->count; i++) {
+        if (strcmp(node->children[i]->name, leaf->name) == 0) {
+            ScopeNode *copy = copy_node(node, 0);
+            release(copy->children[i]);
+            copy->children[i] = leaf;
+            return copy;
+        }
+    }
+    ScopeNode *copy = copy_node(node, 1);
+    copy->children[node->count] = leaf;
+    return copy;
+}
+
+//a new version of the trie at node, at the level that indexes with hash bits from shift on,
+//with leaf in it. Takes leaf, node stays as it was.
+static ScopeNode *insert(ScopeNode *node, int shift, ScopeNode *leaf) {
+    if (!node) {
+        return leaf;
+    }
+    if (node->kind != NODE_BRANCH) {
+        if (node->hash == leaf->hash) {
+            return collide(node, leaf);
+        }
+        //another hash: push node down into a branch of its own, the hashes part at this level or a later one
+        ScopeNode *branch = new_node(NODE_BRANCH, 1);
+        branch->bitmap = 1u << ((node->hash >> shift) & (WIDTH - 1));
+        branch->children[0] = hold(node);
+        ScopeNode *result = insert(branch, shift, leaf);
+        release(branch);
+        return result;
+    }
+    uint32_t bit = 1u << ((leaf->hash >> shift) & (WIDTH - 1));
+    int index = __builtin_popcount(node->bitmap & (bit - 1));
+    if (node->bitmap & bit) {
+        ScopeNode *copy = copy_node(node, 0);
+        ScopeNode *child = insert(node->children[index], shift + BITS, leaf);
+        release(copy->children[index]);
+        copy->children[index] = child;
+        return copy;
+    }
+    ScopeNode *copy = new_node(NODE_BRANCH, node->count + 1);
+    copy->bitmap = node->bitmap | bit;
+    for (int i = 0; i < index; i++) {
+        copy->children[i] = hold(node->children[i]);
+    }
+    copy->children[index] = leaf;
+    for (int i = index; i < node->count; i++) {
+        copy->children[i + 1] = hold(node->children[i]);
+    }
+    return copy;
+}
+
+//the leaf holding name, NULL if there is none
+static ScopeNode *find(ScopeNode *node, const char *name) {
+    uint32_t hash = hash_name(name);
+    for (int shift = 0; node && node->kind == NODE_BRANCH; shift += BITS) {
+        uint32_t bit = 1u << ((hash >> shift) & (WIDTH - 1));
+        if (!(node->bitmap & bit)) {
+            return NULL;
+        }
+        node = node->children[__builtin_popcount(node->bitmap & (bit - 1))];
+    }
+    if (!node || node->hash != hash) {
+        return NULL;
+    }
+    if (node->kind == NODE_LEAF) {
+        return strcmp(node->name, name) == 0 ? node : NULL;
+    }
+    for (int i = 0; i < node->count; i++) {
+        if (strcmp(node->children[i]->name, name) == 0) {
+            return node->children[i];
+        }
+    }
+    return NULL;
+}
+
+//replace root with a version that has name set to value
+static ScopeNode *set_in(ScopeNode *root, const char *name, const char *value) {
+    ScopeNode *next = insert(root, 0, new_leaf(name, value));
+    release(root);
+    return next;
+}
+
+Scope *scope_snapshot() {
+    if (!mirrored) {            //the first snapshot copies the global variables in, later ones are free
+        Scope *outer = mem_scope;
+        mem_scope = NULL;
+        for (int slot = 0; slot < mem_slot_count(); slot++) {
+            const char *value = mem_get_slot(slot);
+            if (value) {
+                global_root = set_in(global_root, mem_slot_name(slot), value);
+            }
+        }
+        mem_scope = outer;
+        mirrored = 1;
+    }
+    Scope *scope = malloc(sizeof(Scope));
+    scope->root = hold(global_root);
+    scope->references = 1;
+    return scope;
+}
+
+void scope_hold(Scope *scope) {
+    scope->references++;
+}
+
+void scope_release(Scope *scope) {
+    if (!scope || --scope->references > 0) {
+        return;
+    }
+    release(scope->root);
+    free(scope);
+}
+
+const char *scope_get(Scope *scope, const char *name) {
+    ScopeNode *leaf = find(scope->root, name);
+    return leaf ? leaf->value : NULL;
+}
+
+void scope_set(Scope *scope, const char *name, const char *value) {
+    scope->root = set_in(scope->root, name, value);
+}
+
+void scope_global_set(const char *name, const char *value) {
+    if (mirrored) {
+        global_root = set_in(global_root, name, value);
+    }
+}
+
+void scope_global_reset() {
+    release(global_root);
+    global_root = NULL;
+    mirrored = 0;
+}
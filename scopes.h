@@ -0,0 +1,32 @@
+#ifndef SCOPES_H
+#   define SCOPES_H
+
+//Variable scopes: a background job (exec ... &) gets its own copy of the variables as they were
+//when it was submitted, so jobs running side by side can set the same name without clobbering
+//each other or the shell. Its processes, and the children their execs start, read and write
+//that copy; the shell and foreground runs keep using the global variables.
+//  export VAR      in a job's script: set VAR in the global variables to the job's value
+//A scope is a persistent hash array mapped trie: 32-way branch nodes indexed by 5 bits of the
+//name's hash at a time, shared between versions and reference counted. Taking a snapshot is
+//holding the root, a set copies the nodes on the path to its name and nothing else, and a read
+//goes through at most 7 branches without locking or copying anything.
+//The global variables are mirrored into a trie from the first snapshot on, so later snapshots
+//cost one reference. Values another shell stored in a --vars file only get into snapshots once
+//this shell has seen them.
+
+typedef struct ScopeNode ScopeNode;
+
+typedef struct Scope {
+    ScopeNode *root;            //current version of the variables, NULL if there are none
+    int references;             //the job and each of its processes
+} Scope;
+
+Scope *scope_snapshot();        //a new scope holding the global variables as they are now, one reference
+void scope_hold(Scope * scope);
+void scope_release(Scope * scope);      //drop a reference, the last one frees the scope, NULL is ignored
+const char *scope_get(Scope * scope, const char *name); //borrowed like mem_get_slot, NULL if it isn't set
+void scope_set(Scope * scope, const char *name, const char *value);
+void scope_global_set(const char *name, const char *value);     //a global variable changed, keep the mirror in step
+void scope_global_reset();      //the global variables were cleared, drop the mirror
+
+#endif
@@ -6,13 +6,34 @@
 #include "shell.h"
 #include "interpreter.h"
 #include "shellmemory.h"
+#include "daemon.h"
+#include "simulator.h"
+#include "jobs.h"
+#include "varstore.h"
+#include "input.h"
 
 int parseInput(char ui[]);
 
 // Start of everything
 int main(int argc, char *argv[]) {
+    // mysh --client SOCKET REQUEST... talks to a running daemon, see daemon.h
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0) {
+        return client_main(argv[2], argc - 3, &argv[3]);
+    }
+
+    // mysh --simulate POLICY [options] evaluates a policy on synthetic jobs, see simulator.h
+    if (argc >= 3 && strcmp(argv[1], "--simulate") == 0) {
+        return simulator_main(argc - 2, &argv[2]);
+    }
+
     printf("Shell version 1.4 created December 2024\n");
 
+    // mysh --daemon SOCKET serves jobs over a Unix socket instead of reading stdin
+    if (argc == 3 && strcmp(argv[1], "--daemon") == 0) {
+        mem_init();
+        return daemon_main(argv[2]);
+    }
+
     char prompt = '$';          // Shell prompt
     char userInput[MAX_USER_INPUT];     // user's input stored here
     // batch_mode is true when a file was given.
@@ -26,18 +47,35 @@ int main(int argc, char *argv[]) {
 
     //init shell memory
     mem_init();
-    while (1) {
-        if (!batch_mode) {
-            printf("%c ", prompt);
+
+    // mysh --vars FILE keeps variables in FILE across shells, see varstore.h
+    if (argc == 3 && strcmp(argv[1], "--vars") == 0 && store_open(argv[2]) != 0) {
+        printf("error: can't use %s as a variable store\n", argv[2]);
+        return 1;
+    }
+
+    // batch input is read in big blocks and its lines are parsed where they are, see input.h
+    if (batch_mode) {
+        input_open(STDIN_FILENO);
+        for (char *line = input_next_line(); line; line = input_next_line()) {
+            errorCode = parseInput(line);
+            if (errorCode == -1)
+                exit(99);       // ignore all other errors
         }
-        // here you should check the unistd library 
-        // so that you can find a way to not display $ in the batch mode
+        jobs_wait(0);           // finish background jobs before exiting
+        return 0;
+    }
+
+    while (1) {
+        printf("%c ", prompt);
+        jobs_run_until_input(); // background jobs run while we wait for the next line
         fgets(userInput, MAX_USER_INPUT - 1, stdin);
         errorCode = parseInput(userInput);
         if (errorCode == -1)
             exit(99);           // ignore all other errors
 
         if (feof(stdin)) {
+            jobs_wait(0);       // finish background jobs before exiting
             return 0;
         }
 
@@ -1,18 +1,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 #include "shellmemory.h"
+#include "varstore.h"
+#include "metrics.h"
+#include "scopes.h"
 
 struct memory_struct {
-    char *var;
-    char *value;
+    char *var;                  //interned name, NULL if the slot is unused
+    char *value;                //current value, NULL if the variable was interned but never set
+    int entry;                  //its entry in the variable store, -1 if it has none (yet)
+    uint32_t version;           //store version value was copied from or written as, see varstore.h
 };
 
-struct memory_struct shellmemory[MEM_SIZE];
+struct memory_struct shellmemory[MEM_SIZE];     //indexed by slot
+static int symbol_count = 0;    //slots handed out so far
+
+//open addressing hash table from names to slot + 1, 0 means empty
+static int symbol_table[SYMBOL_TABLE_SIZE];
+
+int mem_slot_hint = -1;
+Scope *mem_scope = NULL;
 
 //Create global variable named shell_program_memory
-//Initialize next_free field inside struct to 0
-ProgramMemoryShared shell_program_memory = {.next_free = 0 };
+//Every frame starts out free
+ProgramMemoryShared shell_program_memory = {.frames_used = 0 };
 
 // Helper functions
 int match(char *model, char *var) {
@@ -27,74 +40,198 @@ int match(char *model, char *var) {
         return 0;
 }
 
+//FNV-1a, names are short so this is a handful of multiplies
+unsigned int hash_name(const char *name) {
+    unsigned int hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ (unsigned char) *name) * 16777619u;
+    }
+    return hash;
+}
+
+//find the table entry for name: either the entry holding it or the empty entry where it would go
+static int *find_symbol(const char *name) {
+    unsigned int i = hash_name(name) & (SYMBOL_TABLE_SIZE - 1);
+    while (symbol_table[i] != 0 && strcmp(shellmemory[symbol_table[i] - 1].var, name) != 0) {
+        i = (i + 1) & (SYMBOL_TABLE_SIZE - 1);  //linear probing, the table is never more than half full
+    }
+    return &symbol_table[i];
+}
+
 // Shell memory functions
 
 void mem_init() {
     int i;
+    for (i = 0; i < symbol_count; i++) {
+        free(shellmemory[i].var);
+        free(shellmemory[i].value);
+    }
     for (i = 0; i < MEM_SIZE; i++) {
-        shellmemory[i].var = "none";
-        shellmemory[i].value = "none";
+        shellmemory[i].var = NULL;
+        shellmemory[i].value = NULL;
+        shellmemory[i].entry = -1;
+        shellmemory[i].version = 0;
     }
+    memset(symbol_table, 0, sizeof(symbol_table));
+    symbol_count = 0;
+    scope_global_reset();
 }
 
-// Set key value pair
-void mem_set_value(char *var_in, char *value_in) {
-    int i;
+// Get the slot for a name, giving it one if it doesn't have one yet
+int mem_intern(const char *var_in) {
+    int *entry = find_symbol(var_in);
+    if (*entry == 0) {
+        if (symbol_count == MEM_SIZE) {
+            return -1;          //every slot is taken
+        }
+        shellmemory[symbol_count].var = strdup(var_in);
+        *entry = ++symbol_count;
+    }
+    return *entry - 1;
+}
 
-    for (i = 0; i < MEM_SIZE; i++) {
-        if (strcmp(shellmemory[i].var, var_in) == 0) {
-            shellmemory[i].value = strdup(value_in);
-            return;
+// Get the slot for a name without creating it, -1 if it was never interned
+// and isn't in the variable store either
+int mem_lookup(const char *var_in) {
+    int slot = *find_symbol(var_in) - 1;
+    if (slot < 0 && store_attached() && store_find(var_in) >= 0) {
+        slot = mem_intern(var_in);      //set by an earlier or another shell, mem_get_slot copies it in
+    }
+    return slot;
+}
+
+// Pick up a value another shell stored since this one last read or wrote it
+static void refresh_slot(struct memory_struct *memory) {
+    if (memory->entry < 0) {
+        memory->entry = store_find(memory->var);
+        if (memory->entry < 0) {
+            return;             //nobody stored it
         }
     }
+    if (store_version(memory->entry) == memory->version) {
+        return;                 //unchanged, one load
+    }
+    char value[STORE_VALUE_LENGTH];
+    memory->version = store_read(memory->entry, value);
+    if (memory->version == 0) {
+        return;                 //claimed but not written yet
+    }
+    free(memory->value);
+    memory->value = strdup(value);
+}
 
-    //Value does not exist, need to find a free spot.
-    for (i = 0; i < MEM_SIZE; i++) {
-        if (strcmp(shellmemory[i].var, "none") == 0) {
-            shellmemory[i].var = strdup(var_in);
-            shellmemory[i].value = strdup(value_in);
-            return;
+// Borrowed view of a slot's value, NULL if it was never set
+const char *mem_get_slot(int slot) {
+    if (mem_scope) {
+        return scope_get(mem_scope, shellmemory[slot].var);
+    }
+    if (store_attached()) {
+        refresh_slot(&shellmemory[slot]);
+    }
+    return shellmemory[slot].value;
+}
+
+// Set a slot's value. Views of the old value handed out earlier are no longer valid.
+void mem_set_slot(int slot, const char *value_in) {
+    struct memory_struct *memory = &shellmemory[slot];
+    metrics_counters[METRIC_VARIABLE_SETS]++;
+    if (mem_scope) {            //a job's set stays in the job
+        scope_set(mem_scope, memory->var, value_in);
+        return;
+    }
+    scope_global_set(memory->var, value_in);
+    char *old = memory->value;
+    memory->value = strdup(value_in);
+    free(old);
+    if (store_attached()) {     //write through, a name or value too long for the store stays here
+        if (memory->entry < 0) {
+            memory->entry = store_claim(memory->var);
+        }
+        if (memory->entry >= 0) {
+            memory->version = store_write(memory->entry, value_in);
         }
     }
+}
 
-    return;
+// Set key value pair
+void mem_set_value(const char *var_in, const char *value_in) {
+    int slot = mem_intern(var_in);
+    if (slot >= 0) {            //if memory is full the value is dropped, like before
+        mem_set_slot(slot, value_in);
+    }
 }
 
-//get value based on input key
-char *mem_get_value(char *var_in) {
-    int i;
+//get value based on input key, borrowed like mem_get_slot
+const char *mem_get_value(const char *var_in) {
+    int slot = mem_lookup(var_in);
+    if (slot < 0) {
+        return NULL;
+    }
+    return mem_get_slot(slot);
+}
 
-    for (i = 0; i < MEM_SIZE; i++) {
-        if (strcmp(shellmemory[i].var, var_in) == 0) {
-            return strdup(shellmemory[i].value);
+// Copy the variables set before the store was attached into it, later sets write through
+void mem_publish() {
+    for (int slot = 0; slot < symbol_count; slot++) {
+        struct memory_struct *memory = &shellmemory[slot];
+        if (memory->value && (memory->entry = store_claim(memory->var)) >= 0) {
+            memory->version = store_write(memory->entry, memory->value);
         }
     }
-    return NULL;
 }
 
-//reserve block of lines in shared memory for script
-int allocate_program_lines(int number_of_lines) {
-    if (shell_program_memory.next_free + number_of_lines > MAX_PROGRAM_SIZE) {  //check that there's enough space in memory for new script
-        return -1;              //if not enough space, return -1
+int mem_slot_count() {
+    return symbol_count;
+}
+
+const char *mem_slot_name(int slot) {
+    return shellmemory[slot].var;
+}
+
+//work out which variable a script line reads or writes, so running it needs no name lookup
+//only simple one-command lines get a slot: set VAR, print VAR, echo $VAR, my_mkdir $VAR
+static int line_slot(const char *line) {
+    char command[MAX_PROGRAM_LINE_LENGTH], name[MAX_PROGRAM_LINE_LENGTH];
+    if (strchr(line, ';') || sscanf(line, "%99s %99s", command, name) != 2) {
+        return -1;
+    }
+    if (strcmp(command, "set") == 0 || strcmp(command, "print") == 0) {
+        return mem_intern(name);
+    }
+    if ((strcmp(command, "echo") == 0 || strcmp(command, "my_mkdir") == 0) && name[0] == '$') {
+        return mem_intern(name + 1);
     }
-    int start_index = shell_program_memory.next_free;   //save starting index of allocated block
-    shell_program_memory.next_free = shell_program_memory.next_free + number_of_lines;  //change next free index value
-    return start_index;         //if all goes well, return starting index of the allocated block
+    return -1;
 }
 
-//clear block of lines in shared memory
-void free_program_lines(int start, int number_of_lines) {
-    if (start < 0 || start + number_of_lines > MAX_PROGRAM_SIZE) {      //check starting index ins valid and block doesn't extend past end of memory
-        return;
+void intern_program_lines(int start, int number_of_lines) {
+    for (int i = start; i < start + number_of_lines; i++) {
+        shell_program_memory.var_slot[i] = line_slot(shell_program_memory.lines[i]);
     }
+}
 
-    for (int i = start; i < start + number_of_lines; i++) {     //loop through all lines in the block
-        for (int j = 0; j < MAX_PROGRAM_LINE_LENGTH; j++) {     //goes through each character on each line
-            shell_program_memory.lines[i][0] = '\0';    //set character to null terminator, fully zero out each line
+//reserve a free frame
+int allocate_frame() {
+    if (shell_program_memory.frames_used == FRAME_COUNT) {      //every frame holds a page
+        return -1;
+    }
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        if (!shell_program_memory.owner[i]) {
+            shell_program_memory.frames_used++;
+            return i;
         }
     }
+    return -1;
+}
 
-    if (start + number_of_lines == shell_program_memory.next_free) {    //if this block was at the end of shared memory, we can move back next_free
-        shell_program_memory.next_free = start;
+//clear a frame and give it back
+void free_frame(int frame) {
+    if (frame < 0 || frame >= FRAME_COUNT || !shell_program_memory.owner[frame]) {     //check the frame is valid and in use
+        return;
+    }
+    for (int i = frame * FRAME_SIZE; i < (frame + 1) * FRAME_SIZE; i++) {       //loop through all lines in the frame
+        shell_program_memory.lines[i][0] = '\0';        //set first character to null terminator, the line now reads as empty
     }
+    shell_program_memory.owner[frame] = NULL;
+    shell_program_memory.frames_used--;
 }
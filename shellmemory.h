@@ -1,17 +1,55 @@
-#define MEM_SIZE 1000
-#define MAX_PROGRAM_SIZE 1000   //shell memory can hold 1000 lines max
-#define MAX_PROGRAM_LINE_LENGTH 100     //each command(line) in script limited to 100 characters
+#ifndef SHELLMEMORY_H
+#   define SHELLMEMORY_H
+
+#   define MEM_SIZE 1000
+#   define MAX_PROGRAM_SIZE 1000   //shell memory can hold 1000 lines max
+#   define MAX_PROGRAM_LINE_LENGTH 100     //each command(line) in script limited to 100 characters
+#   define SYMBOL_TABLE_SIZE 2048  //hash table for variable names, power of 2 and at least twice MEM_SIZE
+
+//Variables live in numbered slots. A name is interned once and after that
+//reads and writes are an array index. Values handed out are borrowed, not copies,
+//and stay valid until the same variable is set again.
 void mem_init();
-char *mem_get_value(char *var);
-void mem_set_value(char *var, char *value);
+unsigned int hash_name(const char *name);       //FNV-1a of a variable name, for the hash tables
+int mem_intern(const char *var);        //slot for a name, created if needed, -1 if memory is full
+int mem_lookup(const char *var);        //slot for a name, -1 if it was never interned
+const char *mem_get_slot(int slot);     //value in a slot, NULL if never set
+void mem_set_slot(int slot, const char *value);
+const char *mem_get_value(const char *var);     //value of a name, NULL if it doesn't exist
+void mem_set_value(const char *var, const char *value);
+void mem_publish();             //write every variable set so far into a store that was just attached, see varstore.h
+int mem_slot_count();           //slots handed out so far, they are numbered from 0
+const char *mem_slot_name(int slot);    //name interned in a slot
+
+struct Scope;
+extern struct Scope *mem_scope; //variables of the job whose line is running, NULL for the global ones, see scopes.h
+
+extern int mem_slot_hint;       //slot of the variable the instruction being run uses, -1 when unknown
+
+typedef char ProgramLine[MAX_PROGRAM_LINE_LENGTH];     // one line of a script
+
+//Program memory is split into frames of FRAME_SIZE lines. Scripts are split into pages of the
+//same size and a page is only copied into a frame when the script needs it, see paging.h.
+#   define FRAME_SIZE 3            //lines per frame, and per page
+#   define FRAME_COUNT (MAX_PROGRAM_SIZE / FRAME_SIZE)     //frames in program memory
+
+struct PCB;
 
 //memory structure for storing program lines
 typedef struct ProgramMemoryShared {
-    char lines[MAX_PROGRAM_SIZE][MAX_PROGRAM_LINE_LENGTH];      // 2D array. Each row is a line of a script. 100 characters in each row.
-    int next_free;              // Index of the next free line in memory. Allocator will use it to assign new lines to programs.
+    ProgramLine lines[FRAME_COUNT * FRAME_SIZE];        // 2D array. Each row is a line of a script. 100 characters in each row.
+    int var_slot[FRAME_COUNT * FRAME_SIZE];     // Variable slot each line uses, worked out when the line is loaded. -1 if none.
+    struct PCB *owner[FRAME_COUNT];     // Process whose page is in each frame, NULL if the frame is free.
+    int page[FRAME_COUNT];      // Which of the owner's pages is in each frame.
+    unsigned long last_used[FRAME_COUNT];       // When each frame was last read, for LRU.
+    char referenced[FRAME_COUNT];       // Set when each frame is read, cleared by the CLOCK hand.
+    int frames_used;            // Number of frames currently holding a page.
 } ProgramMemoryShared;
 
 extern ProgramMemoryShared shell_program_memory;        //Declare a global shared memory variable, that'll exist in shellmemory.c
 
-int allocate_program_lines(int number_of_lines);        //Function that will reserve a block of lines in shared memory for a new script
-void free_program_lines(int start, int number_of_lines);        //Free previously allocated block of program lines in shared memory
+int allocate_frame();           //Function that will reserve a free frame, -1 if every frame is in use
+void free_frame(int frame);     //Give a frame back
+void intern_program_lines(int start, int number_of_lines);      //Intern the variables a freshly loaded block of lines uses
+
+#endif
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>               // log for exponential draws
+#include <unistd.h>             // getopt
+#include "simulator.h"
+#include "scheduler.h"
+#include "stats.h"
+
+#define NOT_STARTED UINT64_MAX  //first_run of a job that hasn't run yet
+
+enum { DIST_EXP, DIST_UNIFORM, DIST_FIXED, DIST_BIMODAL };
+
+//one synthetic job, indexed by pid - 1
+typedef struct SimJob {
+    int length;                 //instructions
+    uint64_t arrival;           //clock when it enters the ready queue
+    uint64_t first_run;         //clock when its first instruction started
+    uint64_t service;           //clock units spent running its instructions
+} SimJob;
+
+static long job_count = 100000;
+static double mean_length = 20;
+static int distribution = DIST_EXP;
+static double arrival_gap = 0;
+static uint64_t instruction_cost = 1;
+static double run_percent = 0;
+static uint64_t run_cost = 100;
+static uint64_t switch_cost = 0;
+static uint64_t seed = 1;
+
+static SimJob *jobs;
+static long next_arrival = 0;   //first job that hasn't entered the queue yet
+static int sim_policy;
+static uint64_t sim_clock = 0;  //virtual time
+static int last_pid = 0;        //PCB that ran the previous instruction
+static uint64_t context_switches = 0;
+static uint64_t instructions = 0;
+
+static Histogram wait_times, response_times, turnaround_times;
+static double wait_sum, response_sum, turnaround_sum;
+
+//splitmix64, tiny and good enough for workload generation
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+//uniform double in [0, 1)
+static double uniform(uint64_t *state) {
+    *state = mix(*state);
+    return (*state >> 11) * 0x1.0p-53;
+}
+
+static int draw_length(uint64_t *state) {
+    double u = uniform(state);
+    double length;
+    if (distribution == DIST_EXP) {
+        length = -mean_length * log(1 - u);
+    } else if (distribution == DIST_UNIFORM) {
+        length = 1 + u * (2 * mean_length - 1);
+    } else if (distribution == DIST_BIMODAL) {
+        //90% short jobs at half the mean, 10% long ones, so the mean still works out
+        length = uniform(state) < 0.9 ? mean_length / 2 : mean_length * 5.5;
+    } else {
+        length = mean_length;
+    }
+    return length < 1 ? 1 : (int) (length + 0.5);
+}
+
+//cost of one instruction. It only depends on the seed, the job and the pc,
+//so every policy sees exactly the same work.
+static uint64_t cost_of(int pid, int pc) {
+    if (run_percent > 0) {
+        uint64_t state = seed ^ ((uint64_t) pid << 32) ^ (uint64_t) pc;
+        if (uniform(&state) * 100 < run_percent) {
+            return run_cost;
+        }
+    }
+    return instruction_cost;
+}
+
+//put every job whose arrival time has come into the ready queue
+//while the policy is running they go where it wants them, before it starts SJF and AGING sort the queue themselves
+static void inject_arrivals(int running) {
+    while (next_arrival < job_count && jobs[next_arrival].arrival <= sim_clock) {
+        PCB *pcb = create_pcb(next_arrival + 1, NULL, jobs[next_arrival].length);      //no script behind it
+        if (running) {
+            enqueue_arrival(global_queue, pcb, sim_policy);
+        } else {
+            enqueue(global_queue, pcb);
+        }
+        next_arrival++;
+    }
+}
+
+//stands in for parseInput: charge the modelled cost and let new jobs arrive
+static void simulate_instruction(PCB *pcb) {
+    SimJob *job = &jobs[pcb->pid - 1];
+    if (pcb->pid != last_pid) {
+        if (last_pid != 0) {
+            context_switches++;
+        }
+        sim_clock += switch_cost;
+        last_pid = pcb->pid;
+    }
+    if (job->first_run == NOT_STARTED) {
+        job->first_run = sim_clock;
+    }
+    uint64_t cost = cost_of(pcb->pid, pcb->pc);
+    sim_clock += cost;
+    job->service += cost;
+    instructions++;
+    inject_arrivals(1);
+}
+
+//a job finished, record its times
+static void simulate_exit(PCB *pcb) {
+    SimJob *job = &jobs[pcb->pid - 1];
+    uint64_t turnaround = sim_clock - job->arrival;
+    uint64_t response = job->first_run - job->arrival;
+    uint64_t wait = turnaround - job->service;
+    stats_record(&turnaround_times, turnaround);
+    stats_record(&response_times, response);
+    stats_record(&wait_times, wait);
+    turnaround_sum += turnaround;
+    response_sum += response;
+    wait_sum += wait;
+}
+
+static void print_metric(const char *name, Histogram *h, double sum) {
+    printf("%-12s %12.1f %12llu %12llu %12llu %12llu\n", name, sum / h->total,
+           (unsigned long long) stats_percentile(h, 50),
+           (unsigned long long) stats_percentile(h, 90),
+           (unsigned long long) stats_percentile(h, 99), (unsigned long long) h->max);
+}
+
+static int usage() {
+    fprintf(stderr, "usage: mysh --simulate POLICY [-n jobs] [-l mean lines] [-d exp|uniform|fixed|bimodal] [-a arrival gap]\n"
+            "       [-c cost] [-p run percent] [-r run cost] [-x switch cost] [-q time slice] [-g aging step] [-s seed]\n");
+    return 1;
+}
+
+int simulator_main(int argc, char *argv[]) {
+    if (argc < 1 || (sim_policy = policy_from_name(argv[0])) < 0) {
+        return usage();
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:d:a:c:p:r:x:q:g:s:")) != -1) {
+        if (opt == 'n') {
+            job_count = atol(optarg);
+        } else if (opt == 'l') {
+            mean_length = atof(optarg);
+        } else if (opt == 'd') {
+            if (strcmp(optarg, "exp") == 0) {
+                distribution = DIST_EXP;
+            } else if (strcmp(optarg, "uniform") == 0) {
+                distribution = DIST_UNIFORM;
+            } else if (strcmp(optarg, "fixed") == 0) {
+                distribution = DIST_FIXED;
+            } else if (strcmp(optarg, "bimodal") == 0) {
+                distribution = DIST_BIMODAL;
+            } else {
+                return usage();
+            }
+        } else if (opt == 'a') {
+            arrival_gap = atof(optarg);
+        } else if (opt == 'c') {
+            instruction_cost = strtoull(optarg, NULL, 10);
+        } else if (opt == 'p') {
+            run_percent = atof(optarg);
+        } else if (opt == 'r') {
+            run_cost = strtoull(optarg, NULL, 10);
+        } else if (opt == 'x') {
+            switch_cost = strtoull(optarg, NULL, 10);
+        } else if (opt == 'q') {
+            rr_time_slice = rr30_time_slice = share_quantum = atoi(optarg);
+        } else if (opt == 'g') {
+            aging_step = atoi(optarg);
+        } else if (opt == 's') {
+            seed = strtoull(optarg, NULL, 10);
+        } else {
+            return usage();
+        }
+    }
+    if (job_count < 1 || mean_length < 1 || rr_time_slice < 1 || aging_step < 0) {
+        return usage();
+    }
+
+    //the whole workload is drawn up front, so it is the same whatever the policy does with it
+    jobs = calloc(job_count, sizeof(SimJob));
+    if (!jobs) {
+        perror("mysh: simulator");
+        return 1;
+    }
+    uint64_t state = seed;
+    lottery_state = mix(seed);  //never 0, which xorshift can't leave
+    double arrival = 0;
+    for (long i = 0; i < job_count; i++) {
+        jobs[i].length = draw_length(&state);
+        if (i > 0 && arrival_gap > 0) {
+            arrival += -arrival_gap * log(1 - uniform(&state));  //Poisson arrivals
+        }
+        jobs[i].arrival = (uint64_t) arrival;
+        jobs[i].first_run = NOT_STARTED;
+    }
+
+    scheduler_instruction_hook = simulate_instruction;
+    scheduler_exit_hook = simulate_exit;
+    global_queue = create_queue();
+    stats_reset();
+
+    uint64_t started = stats_now();
+    while (next_arrival < job_count || !is_empty(global_queue)) {
+        if (is_empty(global_queue)) {   //idle until the next job shows up
+            if (sim_clock < jobs[next_arrival].arrival) {
+                sim_clock = jobs[next_arrival].arrival;
+            }
+            inject_arrivals(0);
+        }
+        run_policy(global_queue, sim_policy);
+    }
+    double elapsed = (stats_now() - started) / 1e9;
+
+    printf("policy %s, %ld jobs, seed %llu", policy_name(sim_policy), job_count, (unsigned long long) seed);
+    if (sim_policy == POLICY_RR || sim_policy == POLICY_RR30) {
+        printf(", time slice %d", sim_policy == POLICY_RR ? rr_time_slice : rr30_time_slice);
+    } else if (sim_policy == POLICY_AGING) {
+        printf(", aging step %d", aging_step);
+    } else if (sim_policy == POLICY_STRIDE || sim_policy == POLICY_LOTTERY) {
+        printf(", quantum %d", share_quantum);
+    }
+    printf("\nsimulated time %llu, %llu instructions, %llu context switches, throughput %.4f jobs per unit\n",
+           (unsigned long long) sim_clock, (unsigned long long) instructions,
+           (unsigned long long) context_switches, job_count / (double) (sim_clock ? sim_clock : 1));
+    printf("%-12s %12s %12s %12s %12s %12s\n", "METRIC", "MEAN", "P50", "P90", "P99", "MAX");
+    print_metric("wait", &wait_times, wait_sum);
+    print_metric("response", &response_times, response_sum);
+    print_metric("turnaround", &turnaround_times, turnaround_sum);
+    printf("real dispatch overhead: p50 %lluns, p99 %lluns\n",
+           (unsigned long long) stats_percentile(&stats_policies[sim_policy], 50),
+           (unsigned long long) stats_percentile(&stats_policies[sim_policy], 99));
+    printf("simulation took %.2fs (%.1fM instructions/s)\n", elapsed, instructions / elapsed / 1e6);
+
+    destroy_queue(global_queue);
+    global_queue = NULL;
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef SIMULATOR_H
+#   define SIMULATOR_H
+
+//Scheduler simulator: mysh --simulate POLICY [options] runs the real policy code from
+//scheduler.c and readyqueue.c on synthetic PCBs. Instructions aren't parsed, each one just
+//advances a virtual clock by a modelled cost, so millions of jobs take seconds.
+//
+//  -n JOBS       number of jobs (default 100000)
+//  -l LINES      mean job length in instructions (default 20)
+//  -d DIST       job length distribution: exp, uniform, fixed or bimodal (default exp)
+//  -a GAP        mean time between arrivals, 0 means everything arrives at once (default 0)
+//  -c COST       cost of an ordinary instruction (default 1)
+//  -p PERCENT    percentage of instructions that are a run, i.e. fork and wait (default 0)
+//  -r COST       cost of a run instruction (default 100)
+//  -x COST       cost of switching to a different PCB (default 0)
+//  -q SLICE      time slice for RR or RR30, quantum for STRIDE or LOTTERY
+//  -g STEP       aging step for AGING
+//  -s SEED       random seed, the same seed gives the same run (default 1)
+//
+//It reports wait, response and turnaround time distributions in clock units.
+
+int simulator_main(int argc, char *argv[]);     //argv[0] is the policy, returns 0 on success
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "spawn.h"
+#include "shellmemory.h"
+
+extern char **environ;
+
+typedef struct KnownProgram {
+    char *name;                 //as run was given it, NULL if the entry is free
+    char *path;                 //where PATH had it
+} KnownProgram;
+
+static KnownProgram known[SPAWN_CACHE_SIZE];
+static int known_count = 0;
+static char *known_path_variable = NULL;        //PATH the programs were looked up in
+
+void spawn_forget() {
+    for (int i = 0; i < SPAWN_CACHE_SIZE; i++) {
+        free(known[i].name);
+        free(known[i].path);
+        known[i].name = known[i].path = NULL;
+    }
+    known_count = 0;
+}
+
+//entry holding name, or the free entry where it would go
+static KnownProgram *probe(const char *name) {
+    unsigned int i = hash_name(name) & (SPAWN_CACHE_SIZE - 1);
+    while (known[i].name && strcmp(known[i].name, name) != 0) {
+        i = (i + 1) & (SPAWN_CACHE_SIZE - 1);   //linear probing, the table is never full
+    }
+    return &known[i];
+}
+
+//the absolute path PATH has name at, NULL if it has it nowhere or only in a relative directory
+static char *look_up(const char *name, const char *path_variable) {
+    size_t name_length = strlen(name);
+    for (const char *dir = path_variable; *dir;) {
+        size_t dir_length = strcspn(dir, ":");
+        if (dir[0] == '/') {
+            char candidate[dir_length + name_length + 2];
+            memcpy(candidate, dir, dir_length);
+            candidate[dir_length] = '/';
+            memcpy(candidate + dir_length + 1, name, name_length + 1);
+            struct stat info;
+            if (stat(candidate, &info) == 0 && S_ISREG(info.st_mode) && access(candidate, X_OK) == 0) {
+                return strdup(candidate);
+            }
+        } else {
+            return NULL;        //execvp would try this one now, and it depends on the directory we are in
+        }
+        dir += dir_length;
+        dir += *dir == ':';
+    }
+    return NULL;
+}
+
+//the path to start name from, NULL to let posix_spawnp search PATH itself
+static const char *known_program(const char *name) {
+    const char *path_variable = getenv("PATH");
+    if (!path_variable || strchr(name, '/')) {
+        return NULL;
+    }
+    if (!known_path_variable || strcmp(known_path_variable, path_variable) != 0) {
+        spawn_forget();
+        free(known_path_variable);
+        known_path_variable = strdup(path_variable);
+    }
+    KnownProgram *entry = probe(name);
+    if (entry->name) {
+        return entry->path;
+    }
+    if (known_count >= SPAWN_CACHE_SIZE / 2) {
+        return NULL;            //half full is as full as it gets, probes stay short
+    }
+    char *path = look_up(name, path_variable);
+    if (!path) {
+        return NULL;
+    }
+    entry->name = strdup(name);
+    entry->path = path;
+    known_count++;
+    return path;
+}
+
+//a file that is neither a binary nor a #! script: execvp runs it with /bin/sh, so does run
+static int spawn_script(const char *path, char *argv[], pid_t *pid) {
+    int argc = 0;
+    while (argv[argc]) {
+        argc++;
+    }
+    char *shell_argv[argc + 2];
+    shell_argv[0] = "/bin/sh";
+    shell_argv[1] = (char *) path;
+    memcpy(&shell_argv[2], &argv[1], argc * sizeof(char *));    //the arguments and the NULL after them
+    return posix_spawn(pid, "/bin/sh", NULL, NULL, shell_argv, environ);
+}
+
+int spawn_program(char *argv[], pid_t *pid) {
+    const char *path = known_program(argv[0]);
+    if (path) {
+        int error = posix_spawn(pid, path, NULL, NULL, argv, environ);
+        if (error == ENOEXEC) {
+            return spawn_script(path, argv, pid);
+        }
+        if (error != ENOENT && error != EACCES) {
+            return error;
+        }
+        spawn_forget();         //it moved or went away since it was looked up
+    }
+    int error = posix_spawnp(pid, argv[0], NULL, NULL, argv, environ);
+    if (error != ENOEXEC) {
+        return error;
+    }
+    //posix_spawnp doesn't say where it found it, look for it the same way
+    if (strchr(argv[0], '/')) {
+        return spawn_script(argv[0], argv, pid);
+    }
+    const char *path_variable = getenv("PATH");
+    char *found = path_variable ? look_up(argv[0], path_variable) : NULL;
+    if (found) {
+        error = spawn_script(found, argv, pid);
+        free(found);
+    }
+    return error;
+}
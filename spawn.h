@@ -0,0 +1,20 @@
+#ifndef SPAWN_H
+#   define SPAWN_H
+
+#   include <sys/types.h>
+
+//Starting programs for run: posix_spawn, which glibc does with vfork semantics, so the child
+//borrows the shell's memory until it execs instead of copying its page tables, and starting a
+//program takes the same time however big the shell's heap and program memory got.
+//A program named without a slash is looked up in PATH the first time and the path it was found
+//at is remembered. A different PATH forgets everything, a remembered program that is gone is
+//looked up again. Programs found through a relative PATH entry aren't remembered, my_cd would
+//make them wrong. A file that is neither a binary nor a #! script is run with /bin/sh, like
+//execvp does.
+
+#   define SPAWN_CACHE_SIZE 256 //programs remembered, power of 2
+
+int spawn_program(char *argv[], pid_t * pid);   //start argv[0] with argv, returns 0 or an errno value like execvp would fail with
+void spawn_forget();            //forget every remembered program
+
+#endif
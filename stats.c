@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+#include "scheduler.h"
+
+Histogram stats_commands[STAT_COMMAND_COUNT];
+Histogram stats_policies[POLICY_COUNT];
+
+//names in the same order as the STAT_* enum, used both for lookup and for printing
+static const char *stat_names[STAT_COMMAND_COUNT] = {
+    "help", "quit", "set", "print", "echo", "my_ls", "my_mkdir", "my_touch",
+    "my_cd", "source", "run", "exec", "stats", "admission", "paging", "dag",
+    "jobs", "wait", "kill", "group", "checkpoint", "restore", "metrics",
+    "record", "replay", "workers", "quota", "export", "auto",
+    "(unknown)", "run:fork", "run:wait", "admit:wait", "page:fault",
+    "edf:lateness"
+};
+
+int stats_command_id(const char *command) {
+    for (int i = 0; i < STAT_UNKNOWN; i++) {    //only real commands can be looked up
+        if (strcmp(stat_names[i], command) == 0) {
+            return i;
+        }
+    }
+    return STAT_UNKNOWN;
+}
+
+//smallest value that lands in the given bucket, inverse of stats_bucket
+static uint64_t bucket_low(int bucket) {
+    if (bucket < STATS_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / STATS_SUB_BUCKETS - 1;
+    return (uint64_t) (STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << shift;
+}
+
+uint64_t stats_percentile(Histogram *h, double percentile) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile / 100.0 * h->total + 0.5);   //how many samples must be at or below the answer
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            if (i + 1 == STATS_BUCKETS) {
+                return h->max;
+            }
+            uint64_t high = bucket_low(i + 1) - 1;      //report the top of the bucket, like HDR does
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+//print a nanosecond value with a readable unit into buf
+static void format_ns(char *buf, size_t size, uint64_t ns) {
+    if (ns < 10000) {
+        snprintf(buf, size, "%lluns", (unsigned long long) ns);
+    } else if (ns < 10000000) {
+        snprintf(buf, size, "%.1fus", ns / 1000.0);
+    } else if (ns < 10000000000ull) {
+        snprintf(buf, size, "%.1fms", ns / 1000000.0);
+    } else {
+        snprintf(buf, size, "%.1fs", ns / 1000000000.0);
+    }
+}
+
+static void print_row(const char *name, Histogram *h) {
+    char p50[32], p90[32], p99[32], max[32];
+    format_ns(p50, sizeof(p50), stats_percentile(h, 50));
+    format_ns(p90, sizeof(p90), stats_percentile(h, 90));
+    format_ns(p99, sizeof(p99), stats_percentile(h, 99));
+    format_ns(max, sizeof(max), h->max);
+    printf("%-12s %10llu %10s %10s %10s %10s\n", name,
+           (unsigned long long) h->total, p50, p90, p99, max);
+}
+
+void stats_print() {
+    printf("%-12s %10s %10s %10s %10s %10s\n", "COMMAND", "COUNT", "P50",
+           "P90", "P99", "MAX");
+    for (int i = 0; i < STAT_COMMAND_COUNT; i++) {
+        if (stats_commands[i].total > 0) {      //skip commands that were never used
+            print_row(stat_names[i], &stats_commands[i]);
+        }
+    }
+    printf("%-12s %10s %10s %10s %10s %10s\n", "POLICY", "DISPATCHES",
+           "P50", "P90", "P99", "MAX");
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        if (stats_policies[i].total > 0) {
+            print_row(policy_name(i), &stats_policies[i]);
+        }
+    }
+}
+
+void stats_reset() {
+    memset(stats_commands, 0, sizeof(stats_commands));
+    memset(stats_policies, 0, sizeof(stats_policies));
+}
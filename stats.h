@@ -0,0 +1,93 @@
+#ifndef STATS_H
+#   define STATS_H
+
+#   include <stdint.h>
+#   include <time.h>
+
+//Latency histograms are log-bucketed like HDR histograms:
+//values below STATS_SUB_BUCKETS get their own bucket, above that every power of 2 is split into STATS_SUB_BUCKETS linear buckets
+//so each bucket is at most ~6% wide, and recording a value is a count-leading-zeros and an increment
+#   define STATS_SUB_BUCKET_BITS 4
+#   define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#   define STATS_BUCKETS (64 * STATS_SUB_BUCKETS)
+
+typedef struct Histogram {
+    uint64_t counts[STATS_BUCKETS];     //number of samples that fell in each bucket
+    uint64_t total;             //number of samples recorded
+    uint64_t max;               //largest sample recorded, exact
+} Histogram;
+
+//everything interpreter() can dispatch to, one histogram each
+enum {
+    STAT_HELP,
+    STAT_QUIT,
+    STAT_SET,
+    STAT_PRINT,
+    STAT_ECHO,
+    STAT_MY_LS,
+    STAT_MY_MKDIR,
+    STAT_MY_TOUCH,
+    STAT_MY_CD,
+    STAT_SOURCE,
+    STAT_RUN,
+    STAT_EXEC,
+    STAT_STATS,
+    STAT_ADMISSION,
+    STAT_PAGING,
+    STAT_DAG,
+    STAT_JOBS,
+    STAT_WAIT,
+    STAT_KILL,
+    STAT_GROUP,
+    STAT_CHECKPOINT,
+    STAT_RESTORE,
+    STAT_METRICS,
+    STAT_RECORD,
+    STAT_REPLAY,
+    STAT_WORKERS,
+    STAT_QUOTA,
+    STAT_EXPORT,
+    STAT_AUTO,
+    STAT_UNKNOWN,               //anything that ends up in badcommand()
+    STAT_RUN_FORK,              //time spent starting the program (posix_spawn) by run
+    STAT_RUN_WAIT,              //time spent in waitpid() by run
+    STAT_ADMISSION_WAIT,        //time programs spent waiting for shell memory in the admission queue
+    STAT_PAGE_FAULT,            //time spent loading a page after a page fault
+    STAT_DEADLINE_LATENESS,     //how late EDF processes that missed their deadline finished
+    STAT_COMMAND_COUNT
+};
+
+extern Histogram stats_commands[STAT_COMMAND_COUNT];    //per command latencies, indexed by STAT_*
+extern Histogram stats_policies[];      //per policy dispatch overhead, indexed by POLICY_* from scheduler.h
+
+//monotonic clock in nanoseconds, goes through the vDSO so it never enters the kernel
+static inline uint64_t stats_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+//map a value to its bucket
+static inline int stats_bucket(uint64_t value) {
+    if (value < STATS_SUB_BUCKETS) {
+        return (int) value;     //small values are exact
+    }
+    int shift = 63 - __builtin_clzll(value) - STATS_SUB_BUCKET_BITS;    //how far the value is above the linear range
+    return (shift + 1) * STATS_SUB_BUCKETS + (int) ((value >> shift) & (STATS_SUB_BUCKETS - 1));
+}
+
+//record one sample, cheap enough to leave on all the time
+static inline void stats_record(Histogram * h, uint64_t value) {
+    h->counts[stats_bucket(value)]++;
+    h->total++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+int stats_command_id(const char *command);      //look up the STAT_* histogram for a command name
+uint64_t stats_percentile(Histogram * h, double percentile);    //value at or below which percentile% of samples fall
+void stats_print();             //print p50/p90/p99/max for every histogram that has samples
+void stats_reset();             //clear all histograms
+
+#endif
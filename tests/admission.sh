@@ -0,0 +1,74 @@
+#!/bin/sh
+#Fills program memory from a script and checks the admission queue: the order waiting programs
+#get in under FIFO and SMALLEST, refusals past ADMISSION_MAX_PENDING and the frames reserved
+#for admitted processes.
+#Run from the repository root after make: sh tests/admission.sh
+
+MYSH=$(cd "$(dirname "$0")/.." && pwd)/mysh
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+failed=0
+
+#programs of 7 lines have 3 pages and reserve 2 frames each
+for i in 1 2 3; do
+    printf 'set x 1\nset x 2\nset x 3\nset x 4\nset x 5\nset x 6\nset x 7\n' > p$i
+done
+printf 'echo BIG1\necho BIG2\necho BIG3\necho BIG4\n' > big
+echo "echo SMALL1" > small
+
+#fill LINES: LINES script lines that each start 3 programs, under FCFS all of them run
+#only after the script is done
+fill() {
+    for i in $(seq "$1"); do
+        echo "exec p1 p2 p3 FCFS &"
+    done
+}
+
+#expect NAME EXPECTED OUTPUT: OUTPUT has EXPECTED as one of its lines
+expect() {
+    if ! printf '%s\n' "$3" | grep -qxF "$2"; then
+        echo "FAIL: $1: no line \"$2\" in"
+        printf '%s\n' "$3"
+        failed=1
+    fi
+}
+
+#expect_order NAME EXPECTED OUTPUT: the order the BIG and SMALL lines came out of OUTPUT
+expect_order() {
+    got=$(printf '%s\n' "$3" | grep -E '^(BIG|SMALL)' | tr '\n' ' ')
+    if [ "$got" != "$2" ]; then
+        echo "FAIL: $1 ran $got, expected $2"
+        failed=1
+    fi
+}
+
+#the script and 165 programs reserve 332 of the 333 frames: big needs 2, small needs 1
+{ fill 55; echo "exec big small FCFS &"; echo paging; echo admission; } > order
+out=$(printf 'admission FIFO\nexec order FCFS\npaging\nadmission\n' | $MYSH)
+expect "full memory" "replacement: LRU, frames: 333 of 333 in use, 332 reserved, 3 lines each" "$out"
+expect "FIFO waiting" "pending: 2 programs, 5 lines" "$out"
+expect_order "FIFO" "BIG1 BIG2 BIG3 BIG4 SMALL1 " "$out"
+expect "FIFO nothing left reserved" "replacement: LRU, frames: 0 of 333 in use, 0 reserved, 3 lines each" "$out"
+expect "FIFO nothing left waiting" "pending: 0 programs, 0 lines" "$out"
+expect "FIFO counted" "admitted: 168 (2 waited), rejected: 0" "$out"
+
+out=$(printf 'admission SMALLEST\nexec order FCFS\nadmission\n' | $MYSH)
+expect "SMALLEST waiting" "pending: 1 programs, 4 lines" "$out"
+expect_order "SMALLEST" "SMALL1 BIG1 BIG2 BIG3 BIG4 " "$out"
+expect "SMALLEST counted" "admitted: 168 (1 waited), rejected: 0" "$out"
+
+#85 more lines leave 255 programs waiting, 3 more would be past 256 but 1 more still fits
+{ fill 140; echo "exec p1 p2 p3 FCFS &"; echo admission; echo "exec p1 FCFS &"; echo admission; echo paging; } > refuse
+out=$(printf 'exec refuse FCFS\nadmission\npaging\n' | $MYSH)
+expect "refused" "error: admission queue full, try again later" "$out"
+expect "refused programs don't wait" "pending: 255 programs, 1785 lines" "$out"
+expect "the last one fits" "pending: 256 programs, 1792 lines" "$out"
+expect "still full" "replacement: LRU, frames: 333 of 333 in use, 332 reserved, 3 lines each" "$out"
+expect "every one got in" "admitted: 422 (256 waited), rejected: 1" "$out"
+expect "nothing left reserved" "replacement: LRU, frames: 0 of 333 in use, 0 reserved, 3 lines each" "$out"
+
+if [ $failed = 0 ]; then
+    echo "admission ok"
+fi
+exit $failed
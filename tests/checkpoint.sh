@@ -0,0 +1,40 @@
+#!/bin/sh
+#Kills the shell in the middle of a run that takes periodic checkpoints, then restores the last
+#snapshot and checks the run carries on from it, nested execs included.
+#Run from the repository root after make: sh tests/checkpoint.sh
+
+MYSH=$(cd "$(dirname "$0")/.." && pwd)/mysh
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+failed=0
+
+#kills the shell that runs it, only the first time
+printf '[ -e crashed ] || { touch crashed; kill -9 $PPID; }\n' > crash.sh
+printf 'echo A1\nrun sh crash.sh\necho A2\n' > flat
+printf 'echo O1\nexec inner FCFS\necho O2\n' > outer
+printf 'echo I1\nrun sh crash.sh\necho I2\n' > inner
+
+#round_trip NAME SCRIPT BEFORE AFTER: the lines SCRIPT prints before the crash and after the restore
+round_trip() {
+    rm -f crashed snap
+    got=$( (printf 'checkpoint snap 1\nexec %s FCFS\n' "$2" | $MYSH) 2>/dev/null | grep -v '^Shell' | tr '\n' ' ')
+    if [ "$got" != "$3" ]; then
+        echo "FAIL: $1 printed $got before the crash, expected $3"
+        failed=1
+    fi
+    got=$(printf 'restore snap\n' | $MYSH | grep -v '^Shell' | tr '\n' ' ')
+    if [ "$got" != "$4" ]; then
+        echo "FAIL: $1 printed $got after the restore, expected $4"
+        failed=1
+    fi
+}
+
+round_trip "flat" flat "A1 " "A2 "
+#no snapshot is written while outer waits in its exec, the last one restarts the exec
+round_trip "nested exec" outer "O1 I1 " "I1 I2 O2 "
+
+if [ $failed = 0 ]; then
+    echo "checkpoint ok"
+fi
+exit $failed
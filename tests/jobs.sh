@@ -0,0 +1,34 @@
+#!/bin/sh
+#Kills background jobs whose scripts started programs of their own and checks that nothing of
+#the job runs afterwards and that it stays KILLED.
+#Run from the repository root after make: sh tests/jobs.sh
+
+MYSH=$(cd "$(dirname "$0")/.." && pwd)/mysh
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+failed=0
+
+printf 'echo O1\nexec inner RR\necho O2\n' > nested
+printf 'echo O1\nexec inner RR &\necho O2\n' > async
+printf 'echo I1\necho I2\necho I3\necho I4\necho I5\necho I6\n' > inner
+printf 'echo S1\necho S2\necho S3\n' > short
+
+#expect_kill NAME SCRIPT EXPECTED: what the job running SCRIPT prints, killed once short is done
+expect_kill() {
+    got=$(printf 'exec %s RR &\nexec short RR &\nwait 2\nkill 1\njobs\nwait\n' "$2" | $MYSH | grep -v '^Shell' | tr '\n' ' ')
+    if [ "$got" != "$3" ]; then
+        echo "FAIL: $1 printed $got, expected $3"
+        failed=1
+    fi
+}
+
+#the parent waits in its exec when the kill comes
+expect_kill "nested exec" nested "[1] [2] O1 S1 S2 I1 I2 S3 [1] KILLED RR 2/3 "
+#the parent is over but its children still run
+expect_kill "exec &" async "[1] [2] O1 S1 S2 I1 I2 O2 S3 [1] KILLED RR 3/3 "
+
+if [ $failed = 0 ]; then
+    echo "jobs ok"
+fi
+exit $failed
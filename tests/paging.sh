@@ -0,0 +1,52 @@
+#!/bin/sh
+#Runs scripts longer than program memory under each page replacement policy and checks every
+#line still runs once, in order, with the expected page faults and evictions.
+#Run from the repository root after make: sh tests/paging.sh
+
+MYSH=$(cd "$(dirname "$0")/.." && pwd)/mysh
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+failed=0
+
+#long has 1200 lines (400 pages), more than the 333 frames * 3 lines, short has 500
+seq 1200 | sed 's/^/echo L/' > long
+seq 500 | sed 's/^/echo S/' > short
+seq 1200 | sed 's/^/L/' > L.expected
+seq 500 | sed 's/^/S/' > S.expected
+
+#check NAME PREFIX OUTPUT: the PREFIX lines of OUTPUT are the script's lines, in order
+check() {
+    if ! printf '%s\n' "$3" | grep "^$2[0-9]" | cmp -s - "$2.expected"; then
+        echo "FAIL: $1 didn't run every $2 line once, in order"
+        failed=1
+    fi
+}
+
+#expect NAME EXPECTED OUTPUT: OUTPUT has EXPECTED as one of its lines
+expect() {
+    if ! printf '%s\n' "$3" | grep -qxF "$2"; then
+        echo "FAIL: $1: no line \"$2\" in"
+        printf '%s\n' "$3" | grep -v '^[LS][0-9]'
+        failed=1
+    fi
+}
+
+#only the first 2 pages are loaded up front, every other page faults once and the last 67
+#don't fit without evicting; both policies evict the same pages as no page is read twice
+for policy in LRU CLOCK; do
+    out=$(printf 'paging %s\nexec long FCFS\npaging\n' "$policy" | $MYSH)
+    check "$policy long" L "$out"
+    expect "$policy long" "loads: 2, faults: 398, evictions: 67" "$out"
+    expect "$policy frames given back" "replacement: $policy, frames: 0 of 333 in use, 0 reserved, 3 lines each" "$out"
+
+    out=$(printf 'paging %s\nexec long short RR\npaging\n' "$policy" | $MYSH)
+    check "$policy RR" L "$out"
+    check "$policy RR" S "$out"
+    expect "$policy RR" "loads: 4, faults: 563, evictions: 67" "$out"
+done
+
+if [ $failed = 0 ]; then
+    echo "paging ok"
+fi
+exit $failed
@@ -0,0 +1,32 @@
+#!/bin/sh
+#Runs the same execs in the shell and on worker processes and checks the lines come out in the same order.
+#Run from the repository root after make: sh tests/workers.sh
+
+cd "$(dirname "$0")" || exit 1
+MYSH=../mysh
+failed=0
+
+#the order exec with policy $2 runs the test scripts in, on $1 workers
+order() {
+    printf 'workers %s\nexec a.txt b.txt c.txt %s\n' "$1" "$2" | $MYSH | grep '^[ABC][0-9]' | tr '\n' ' '
+}
+
+#expect_order POLICY WORKERS EXPECTED
+expect_order() {
+    got=$(order "$2" "$1")
+    if [ "$got" != "$3" ]; then
+        echo "FAIL: $1 on $2 workers ran $got, expected $3"
+        failed=1
+    fi
+}
+
+#a.txt has 5 lines, b.txt 2, c.txt 3
+for workers in 0 1; do
+    expect_order RR $workers "A1 A2 B1 B2 C1 C2 A3 A4 C3 A5 "
+    expect_order SJF $workers "B1 B2 C1 C2 C3 A1 A2 A3 A4 A5 "
+done
+
+if [ $failed = 0 ]; then
+    echo "workers ok"
+fi
+exit $failed
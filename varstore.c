@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "varstore.h"
+#include "shellmemory.h"
+
+#define STORE_MAGIC "MYSHVAR1"  //also the layout version
+
+enum { ENTRY_EMPTY, ENTRY_USED };
+
+typedef struct StoreEntry {
+    uint32_t state;             //ENTRY_*, becomes ENTRY_USED only once name is written
+    uint32_t sequence;          //odd while a write is going, otherwise twice the writes so far
+    uint32_t current;           //which copy of the value is whole
+    char name[STORE_NAME_LENGTH];
+    char value[2][STORE_VALUE_LENGTH];
+} StoreEntry;
+
+typedef struct StoreFile {
+    char magic[8];
+    uint32_t entry_count;
+    uint32_t entry_size;        //a file from a build with other lengths is refused
+    StoreEntry entries[STORE_ENTRIES];
+} StoreFile;
+
+static StoreFile *store = NULL; //mapped file, NULL if there is no store
+static int store_fd = -1;       //kept open for flock
+
+int store_open(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    flock(fd, LOCK_EX);         //a shell creating the file finishes before anyone else looks at it
+    struct stat info;
+    int fresh = fstat(fd, &info) == 0 && info.st_size == 0;
+    if (fresh && ftruncate(fd, sizeof(StoreFile)) != 0) {
+        fresh = -1;
+    }
+    StoreFile *mapped = MAP_FAILED;
+    if (fresh >= 0 && (fresh || info.st_size == sizeof(StoreFile))) {
+        mapped = mmap(NULL, sizeof(StoreFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapped != MAP_FAILED && fresh) {        //a new file is all zeroes, every entry is already empty
+        mapped->entry_count = STORE_ENTRIES;
+        mapped->entry_size = sizeof(StoreEntry);
+        memcpy(mapped->magic, STORE_MAGIC, sizeof(mapped->magic));
+    }
+    flock(fd, LOCK_UN);
+    if (mapped == MAP_FAILED || memcmp(mapped->magic, STORE_MAGIC, sizeof(mapped->magic)) != 0
+        || mapped->entry_count != STORE_ENTRIES || mapped->entry_size != sizeof(StoreEntry)) {
+        if (mapped != MAP_FAILED) {
+            munmap(mapped, sizeof(StoreFile));
+        }
+        close(fd);
+        return -1;
+    }
+    store = mapped;
+    store_fd = fd;
+    return 0;
+}
+
+int store_open_private() {
+    int fd = memfd_create("mysh-vars", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);       //opens the memfd again, it starts out empty like a new file
+    int status = store_open(path);
+    close(fd);
+    return status;
+}
+
+void store_reopen() {
+    if (!store) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", store_fd);
+    int fd = open(path, O_RDWR);        //a new open file description of the same file
+    if (fd >= 0) {
+        dup2(fd, store_fd);
+        close(fd);
+    }
+}
+
+int store_attached() {
+    return store != NULL;
+}
+
+//entry holding name, or the empty entry where it would go, -1 if neither is in the table
+static int probe(const char *name) {
+    unsigned int i = hash_name(name) & (STORE_ENTRIES - 1);
+    for (int probes = 0; probes < STORE_ENTRIES; probes++) {
+        StoreEntry *entry = &store->entries[i];
+        if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) == ENTRY_EMPTY
+            || strncmp(entry->name, name, STORE_NAME_LENGTH) == 0) {
+            return i;
+        }
+        i = (i + 1) & (STORE_ENTRIES - 1);      //linear probing, like the symbol table
+    }
+    return -1;
+}
+
+int store_find(const char *name) {
+    if (strlen(name) >= STORE_NAME_LENGTH) {
+        return -1;
+    }
+    int i = probe(name);
+    return i >= 0 && __atomic_load_n(&store->entries[i].state, __ATOMIC_ACQUIRE) == ENTRY_USED ? i : -1;
+}
+
+int store_claim(const char *name) {
+    if (strlen(name) >= STORE_NAME_LENGTH) {
+        return -1;
+    }
+    int i = store_find(name);
+    if (i >= 0) {
+        return i;
+    }
+    flock(store_fd, LOCK_EX);
+    i = probe(name);            //again, another shell may have claimed it meanwhile
+    if (i >= 0 && store->entries[i].state == ENTRY_EMPTY) {
+        strcpy(store->entries[i].name, name);
+        __atomic_store_n(&store->entries[i].state, ENTRY_USED, __ATOMIC_RELEASE);     //readers only look at the name after this
+    }
+    flock(store_fd, LOCK_UN);
+    return i;
+}
+
+uint32_t store_version(int entry) {
+    return __atomic_load_n(&store->entries[entry].sequence, __ATOMIC_ACQUIRE);
+}
+
+//a writer that died between its two increments left the sequence odd, the copy current
+//points at is still whole, so finishing the increment is all the repair there is
+//called with the lock held
+static void repair(StoreEntry *entry) {
+    if (entry->sequence & 1) {
+        __atomic_add_fetch(&entry->sequence, 1, __ATOMIC_RELEASE);
+    }
+}
+
+//copy the whole copy, a concurrent writer may be rewriting it so its terminator can't be trusted
+static void copy_value(StoreEntry *entry, char value[STORE_VALUE_LENGTH]) {
+    memcpy(value, entry->value[__atomic_load_n(&entry->current, __ATOMIC_ACQUIRE)], STORE_VALUE_LENGTH);
+    value[STORE_VALUE_LENGTH - 1] = '\0';
+}
+
+uint32_t store_read(int i, char value[STORE_VALUE_LENGTH]) {
+    StoreEntry *entry = &store->entries[i];
+    for (int attempt = 0; attempt < 100; attempt++) {
+        uint32_t before = store_version(i);
+        if (before & 1) {
+            continue;           //a write is going
+        }
+        copy_value(entry, value);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&entry->sequence, __ATOMIC_RELAXED) == before) {
+            return before;
+        }
+    }
+    //the writer is slow or died part way through, wait for the lock and look again
+    flock(store_fd, LOCK_EX);
+    repair(entry);
+    copy_value(entry, value);
+    uint32_t version = entry->sequence;
+    flock(store_fd, LOCK_UN);
+    return version;
+}
+
+uint32_t store_write(int i, const char *value) {
+    if (strlen(value) >= STORE_VALUE_LENGTH) {
+        return 0;
+    }
+    StoreEntry *entry = &store->entries[i];
+    flock(store_fd, LOCK_EX);
+    repair(entry);
+    uint32_t next = 1 - entry->current;
+    __atomic_add_fetch(&entry->sequence, 1, __ATOMIC_RELEASE);  //odd, readers retry
+    strcpy(entry->value[next], value);
+    __atomic_store_n(&entry->current, next, __ATOMIC_RELEASE);  //the new value is whole from here on
+    uint32_t version = __atomic_add_fetch(&entry->sequence, 1, __ATOMIC_RELEASE);
+    flock(store_fd, LOCK_UN);
+    return version;
+}
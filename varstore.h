@@ -0,0 +1,33 @@
+#ifndef VARSTORE_H
+#   define VARSTORE_H
+
+#   include <stdint.h>
+
+//Persistent variables: mysh --vars FILE keeps shell variables in FILE as well as in shell
+//memory. FILE is mapped shared and laid out as an open addressing hash table, so a variable
+//set by one shell is there for every later shell, and for shells already running on the same
+//FILE, without replaying any set commands. A variable is only read from FILE when a shell
+//first looks it up or when its version in FILE changed since the shell last saw it.
+//
+//Every entry holds two copies of its value and says which one is whole. A write goes to the
+//other copy and then flips that index with one aligned store, so a shell killed part way
+//through a set leaves the old value in place. Writers take an flock on FILE, readers don't:
+//a sequence number that is odd while a write is going lets them retry instead.
+//Names or values of STORE_NAME_LENGTH or STORE_VALUE_LENGTH characters or more stay in the
+//shell that set them.
+
+#   define STORE_ENTRIES 2048   //power of 2, twice MEM_SIZE like the symbol table
+#   define STORE_NAME_LENGTH 200        //words are at most 199 characters, see parseInput
+#   define STORE_VALUE_LENGTH 200
+
+int store_open(const char *path);       //map path, creating it if needed, returns 0 or -1
+int store_open_private();       //map a store no file backs, shared only with processes forked from now on, returns 0 or -1
+void store_reopen();            //in a forked process: lock the store with a descriptor of its own, flock doesn't exclude processes sharing one
+int store_attached();           //whether a store is open
+int store_find(const char *name);       //entry holding name, -1 if there is none
+int store_claim(const char *name);      //entry for name, created if needed, -1 if the name is too long or the store is full
+uint32_t store_version(int entry);      //changes whenever the entry's value does, 0 if it was never set
+uint32_t store_read(int entry, char value[STORE_VALUE_LENGTH]); //copy the value out, returns its version
+uint32_t store_write(int entry, const char *value);     //returns the new version, 0 if the value is too long to store
+
+#endif
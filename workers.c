@@ -0,0 +1,441 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "workers.h"
+#include "checkpoint.h"
+#include "decisions.h"
+#include "jobs.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "shell.h"
+#include "shellmemory.h"
+#include "varstore.h"
+
+#ifndef MPOL_PREFERRED
+#   define MPOL_PREFERRED 1     //from numaif.h, which is only there with libnuma
+#endif
+
+int worker_count = 0;
+int worker_pinning = 0;
+
+//a process of the exec, as the workers see it. Workers store pc after every line, a cache line
+//each keeps them from invalidating each other's tasks
+typedef struct WorkerTask {
+    int pid;                    //pid it would have had in the shell, for messages
+    size_t lines;               //offset of its lines from the start of the region
+    int number_of_lines;
+    int pc;                     //next line to run, stored after every line so a dead worker's process resumes there
+    int next;                   //task behind it in the ready queue, -1 at the tail
+    int worker;                 //worker running it, -1 if it is queued or done
+    int last_worker;            //worker that ran it last (or its home worker, see place_lines), -1 for none
+    int passed;                 //a worker took a task behind it to stay on its own, it isn't passed again
+    int crash_pc;               //line it last killed a worker in
+    int crashes;                //workers it killed there
+} __attribute__((aligned(64))) WorkerTask;
+
+//everything the shell and its workers share, mapped from a memfd
+typedef struct WorkerRegion {
+    uint32_t lock;              //futex: 0 free, 1 held, 2 held and someone may be waiting for it
+    pid_t holder;               //process holding it, so the shell can free it if a worker dies with it
+    uint32_t changed;           //futex idle workers sleep on, bumped when a task is queued or the last one is done
+    int head, tail;             //ready queue, -1 if empty
+    int remaining;              //tasks not done yet
+    int task_count;
+    int slice;                  //lines a worker runs per dispatch, 0 for all of them
+    int quit;                   //a script ended the shell, exit status + 1
+    uint64_t instructions;      //lines run, for the metrics
+    uint64_t migrations;        //tasks a worker took over from another one
+    uint64_t node_migrations;   //those that came from another NUMA node
+    WorkerTask tasks[];         //one per program, followed by every program's lines
+} WorkerRegion;
+
+static WorkerRegion *region = NULL;
+static pid_t self;              //getpid() of this process, it goes in holder
+static pid_t workers[WORKERS_MAX];      //pid of each worker, 0 if it isn't running
+static int worker_cpus[WORKERS_MAX];    //CPU each worker is pinned to, -1 if it isn't
+static int worker_nodes[WORKERS_MAX];   //NUMA node of that CPU
+
+//not FUTEX_PRIVATE_FLAG, the words are in memory other processes map too
+static long futex(uint32_t *word, int op, uint32_t value) {
+    return syscall(SYS_futex, word, op, value, NULL, NULL, 0);
+}
+
+//a waiter marks the lock 2 so the holder knows to wake someone, see Drepper's "Futexes Are Tricky"
+static void lock() {
+    uint32_t state = 0;
+    if (!__atomic_compare_exchange_n(&region->lock, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        if (state != 2) {
+            state = __atomic_exchange_n(&region->lock, 2, __ATOMIC_ACQUIRE);
+        }
+        while (state != 0) {
+            futex(&region->lock, FUTEX_WAIT, 2);
+            state = __atomic_exchange_n(&region->lock, 2, __ATOMIC_ACQUIRE);
+        }
+    }
+    region->holder = self;
+}
+
+static void unlock() {
+    region->holder = 0;
+    if (__atomic_exchange_n(&region->lock, 0, __ATOMIC_RELEASE) == 2) {
+        futex(&region->lock, FUTEX_WAKE, 1);
+    }
+}
+
+//tell up to count idle workers the queue changed, called with the lock held
+static void announce(int count) {
+    __atomic_add_fetch(&region->changed, 1, __ATOMIC_RELEASE);
+    futex(&region->changed, FUTEX_WAKE, count);
+}
+
+//called with the lock held
+static void push(int task, int front) {
+    region->tasks[task].next = -1;
+    if (region->head < 0) {
+        region->head = region->tail = task;
+    } else if (front) {
+        region->tasks[task].next = region->head;
+        region->head = task;
+    } else {
+        region->tasks[region->tail].next = task;
+        region->tail = task;
+    }
+}
+
+//called with the lock held: the head, or the first task worker ran last among the first
+//WORKER_AFFINITY_SCAN in the queue if every task before it already had a slice and was never
+//passed over. A passed task ends up at the head with passed set, and is taken next, so round
+//robin order is off by at most one slice. -1 if the queue is empty
+static int pop(int worker) {
+    WorkerTask *tasks = region->tasks;
+    int chosen = region->head, previous = -1;
+    int before = -1;
+    for (int t = region->head, scanned = 0; t >= 0 && scanned < WORKER_AFFINITY_SCAN; before = t, t = tasks[t].next, scanned++) {
+        if (tasks[t].last_worker == worker) {
+            chosen = t;
+            previous = before;
+            break;
+        }
+        if (tasks[t].passed || tasks[t].pc == 0) {      //it waited long enough, or hasn't had its first slice
+            break;
+        }
+    }
+    if (chosen < 0) {
+        return -1;
+    }
+    for (int t = region->head; t != chosen; t = tasks[t].next) {
+        tasks[t].passed = 1;
+    }
+    if (previous < 0) {
+        region->head = tasks[chosen].next;
+    } else {
+        tasks[previous].next = tasks[chosen].next;
+    }
+    if (region->tail == chosen) {
+        region->tail = previous;
+    }
+    tasks[chosen].passed = 0;
+    return chosen;
+}
+
+//what a worker does until every task is done
+static void worker_main(int index) {
+    self = getpid();
+    worker_count = 0;           //an exec one of its lines runs, runs in it
+    metrics_interval_ns = 0;    //the shell writes the metrics and checkpoints and logs decisions, not its copies
+    checkpoint_every = 0;
+    decisions_record(NULL);
+    store_reopen();
+    if (worker_cpus[index] >= 0) {
+        cpu_set_t cpu;
+        CPU_ZERO(&cpu);
+        CPU_SET(worker_cpus[index], &cpu);
+        sched_setaffinity(0, sizeof(cpu), &cpu);        //if it can't be pinned it still runs, just anywhere
+    }
+
+    lock();
+    while (region->remaining > 0 && !region->quit) {
+        int t = pop(index);
+        if (t < 0) {            //every task left is running on another worker
+            uint32_t seen = region->changed;
+            unlock();
+            futex(&region->changed, FUTEX_WAIT, seen);  //returns straight away if it changed since
+            lock();
+            continue;
+        }
+        WorkerTask *task = &region->tasks[t];
+        task->worker = index;
+        if (task->last_worker >= 0 && task->last_worker != index) {
+            region->migrations++;
+            region->node_migrations += worker_nodes[task->last_worker] != worker_nodes[index];
+        }
+        task->last_worker = index;
+        unlock();
+
+        ProgramLine *lines = (ProgramLine *) ((char *) region + task->lines);
+        for (int ran = 0; task->pc < task->number_of_lines && (region->slice == 0 || ran < region->slice); ran++) {
+            ProgramLine instruction;
+            strcpy(instruction, lines[task->pc]);       //parseInput writes into it
+            parseInput(instruction);
+            fflush(stdout);     //lines of different workers come out in the order they ran
+            __atomic_add_fetch(&region->instructions, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&task->pc, task->pc + 1, __ATOMIC_RELEASE);
+        }
+
+        lock();
+        task->worker = -1;
+        if (task->pc < task->number_of_lines) {
+            push(t, 0);
+            announce(1);
+        } else if (--region->remaining == 0) {
+            announce(INT_MAX);  //wake everyone so they see there is nothing left
+        }
+    }
+    unlock();
+    jobs_wait(0);               //background jobs its lines started
+    fflush(stdout);
+    _exit(0);
+}
+
+//the NUMA node cpu is on, 0 if sysfs doesn't say
+static int cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    int node = 0;
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) && sscanf(entry->d_name, "node%d", &node) != 1);
+        closedir(dir);
+    }
+    return node;
+}
+
+//pick the CPU each worker is pinned to, in turn from the ones the shell may run on,
+//returns how many NUMA nodes the workers are spread over
+static int place_workers() {
+    for (int i = 0; i < worker_count; i++) {
+        worker_cpus[i] = -1;
+        worker_nodes[i] = 0;
+    }
+    cpu_set_t allowed;
+    if (!worker_pinning || sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return 1;
+    }
+    int cpu = -1, nodes = 0;
+    for (int i = 0; i < worker_count; i++) {
+        do {
+            cpu = (cpu + 1) % CPU_SETSIZE;
+        } while (!CPU_ISSET(cpu, &allowed));
+        worker_cpus[i] = cpu;
+        worker_nodes[i] = cpu_node(cpu);
+        int j;
+        for (j = 0; j < i && worker_nodes[j] != worker_nodes[i]; j++);
+        nodes += j == i;
+    }
+    return nodes;
+}
+
+//ask for the pages of the region from offset on, which nothing has touched yet, to come from node
+static void prefer_node(size_t offset, size_t length, int node) {
+#ifdef SYS_mbind
+    unsigned long mask[16] = { 0 };
+    if (node < (int) (sizeof(mask) * CHAR_BIT)) {
+        mask[node / (sizeof(long) * CHAR_BIT)] = 1ul << node % (sizeof(long) * CHAR_BIT);
+        syscall(SYS_mbind, (char *) region + offset, length, MPOL_PREFERRED, mask, sizeof(mask) * CHAR_BIT, 0);
+    }
+#endif
+}
+
+//where lines that would start at offset go: a page of their own when they are placed on a node
+static size_t lines_start(size_t offset, int placed) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    return placed ? (offset + page - 1) / page * page : offset;
+}
+
+static int start_worker(int index) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        worker_main(index);
+    }
+    workers[index] = pid > 0 ? pid : 0;
+    return pid > 0 ? 0 : -1;
+}
+
+//worker index ended with status: free what it held and deal with the process it was running,
+//returns 1 if it was killed and should be replaced
+static int worker_ended(int index, pid_t pid, int status) {
+    if (region->holder == pid) {        //killed in the middle of a queue operation, they are too short to leave a mess
+        region->holder = 0;
+        __atomic_store_n(&region->lock, 0, __ATOMIC_RELEASE);
+        futex(&region->lock, FUTEX_WAKE, 1);
+    }
+    if (WIFSIGNALED(status) && !region->quit) {       //after a quit the shell stopped it
+        printf("error: worker %d was killed by signal %d\n", index + 1, WTERMSIG(status));
+    }
+    lock();
+    for (int t = 0; t < region->task_count; t++) {
+        WorkerTask *task = &region->tasks[t];
+        if (task->worker != index) {
+            continue;
+        }
+        task->worker = -1;
+        if (WIFEXITED(status)) {        //a line ran quit, or failed the way that ends the shell
+            region->quit = WEXITSTATUS(status) + 1;
+            announce(INT_MAX);
+        } else {
+            if (task->crash_pc != task->pc) {
+                task->crash_pc = task->pc;
+                task->crashes = 0;
+            }
+            if (++task->crashes < WORKER_CRASHES_MAX) {
+                push(t, 1);     //it runs the line it died in again, before anything else
+                announce(1);
+            } else {
+                printf("error: process %d killed %d workers in line %d, it is dropped\n", task->pid, task->crashes,
+                       task->pc + 1);
+                if (--region->remaining == 0) {
+                    announce(INT_MAX);
+                }
+            }
+        }
+    }
+    unlock();
+    fflush(stdout);
+    return WIFSIGNALED(status);
+}
+
+int workers_run(BackingStore *programs[], int program_count, int policy) {
+    int slice;
+    if (policy == POLICY_FCFS || policy == POLICY_SJF) {
+        slice = 0;
+    } else if (policy == POLICY_RR) {
+        slice = rr_time_slice;
+    } else if (policy == POLICY_RR30) {
+        slice = rr30_time_slice;
+    } else {
+        return -1;
+    }
+    if (!store_attached()) {
+        if (store_open_private() != 0) {
+            return -1;
+        }
+        mem_publish();
+    }
+
+    int placed = place_workers() > 1;   //each program's lines go on the node of the worker it starts on
+    size_t size = sizeof(WorkerRegion) + program_count * sizeof(WorkerTask);
+    for (int i = 0; i < program_count; i++) {
+        size = lines_start(size, placed) + programs[i]->line_count * sizeof(ProgramLine);
+    }
+    int fd = memfd_create("mysh-workers", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    region = ftruncate(fd, size) == 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (region == MAP_FAILED) {
+        region = NULL;
+        return -1;
+    }
+
+    //a new memfd is all zeroes, the lock is free
+    self = getpid();
+    region->head = region->tail = -1;
+    region->remaining = region->task_count = program_count;
+    region->slice = slice;
+    size_t offset = sizeof(WorkerRegion) + program_count * sizeof(WorkerTask);
+    for (int i = 0; i < program_count; i++) {
+        WorkerTask *task = &region->tasks[i];
+        task->pid = allocate_pid();
+        task->lines = offset = lines_start(offset, placed);
+        task->number_of_lines = programs[i]->line_count;
+        task->worker = -1;
+        task->last_worker = placed ? i % worker_count : -1;    //its home worker, which its lines are near
+        task->crash_pc = -1;
+        if (placed && task->number_of_lines > 0) {
+            prefer_node(offset, task->number_of_lines * sizeof(ProgramLine), worker_nodes[i % worker_count]);
+        }
+        backing_load(programs[i], (ProgramLine *) ((char *) region + offset));
+        offset += task->number_of_lines * sizeof(ProgramLine);
+    }
+    for (int i = 0; i < program_count; i++) {
+        int *link = &region->head;      //SJF queues shorter programs first, ties in exec order
+        while (policy == POLICY_SJF && *link >= 0 && region->tasks[*link].number_of_lines <= region->tasks[i].number_of_lines) {
+            link = &region->tasks[*link].next;
+        }
+        if (policy != POLICY_SJF || *link < 0) {
+            push(i, 0);
+        } else {                //in front of the first longer one
+            region->tasks[i].next = *link;
+            *link = i;
+        }
+    }
+
+    fflush(NULL);               //or every worker writes out what is buffered again
+    int live = 0;
+    for (int i = 0; i < worker_count; i++) {
+        live += start_worker(i) == 0;
+    }
+    if (live == 0) {
+        munmap(region, size);
+        region = NULL;
+        return -1;
+    }
+
+    while (live > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        int index;
+        for (index = 0; index < worker_count && workers[index] != pid; index++);
+        if (index == worker_count) {
+            continue;           //not a worker
+        }
+        workers[index] = 0;
+        live--;
+        if (worker_ended(index, pid, status) && region->remaining > 0 && !region->quit && start_worker(index) == 0) {
+            live++;
+            metrics_counters[METRIC_WORKER_RESTARTS]++;
+        }
+        for (int i = 0; region->quit && i < worker_count; i++) {
+            if (workers[i]) {
+                kill(workers[i], SIGKILL);      //the shell is ending, the other processes stop where they are
+            }
+        }
+    }
+
+    if (region->remaining > 0 && !region->quit) {
+        printf("error: no workers left, %d processes are dropped\n", region->remaining);
+    }
+    metrics_instructions[policy] += region->instructions;
+    metrics_counters[METRIC_WORKER_MIGRATIONS] += region->migrations;
+    metrics_counters[METRIC_WORKER_NODE_MIGRATIONS] += region->node_migrations;
+    int quit = region->quit;
+    munmap(region, size);
+    region = NULL;
+    for (int i = 0; i < program_count; i++) {
+        backing_close(programs[i]);
+    }
+    if (quit) {
+        exit(quit - 1);         //the worker already said Bye!
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef WORKERS_H
+#   define WORKERS_H
+
+#   include "paging.h"
+
+//Worker processes: after workers N, a foreground exec runs its programs on N forked worker
+//processes instead of in the shell, so they use N cores and a line that crashes takes down a
+//worker, not the shell.
+//  workers         print how many workers execs use, 0 if they run in the shell, and if they are pinned
+//  workers N       use N workers from the next exec on, 0 runs them in the shell again
+//  workers pin on|off      pin each worker to a CPU of its own, taken in turn from the ones the
+//                  shell may run on (more workers than CPUs share them)
+//The exec copies every line of its scripts and a ready queue of its processes into a memfd
+//region mapped shared, then forks the workers. A worker takes the process at the head of the
+//queue, runs its lines (to the end under FCFS and SJF, a time slice under RR and RR30) and puts
+//it back at the tail, with the queue behind a futex lock the processes share. The shell
+//supervises: a worker killed by a signal is replaced, and the process it was running goes
+//back to the head of the queue at the line it died in. A process that kills two workers in the
+//same line is dropped. quit in a script ends the shell, as it always did, and stops the other
+//workers.
+//A worker prefers the processes it ran last, whose lines and variables its cache still has: it
+//takes the first of them among the WORKER_AFFINITY_SCAN at the head of the queue, as long as
+//the ones it passes over all had a slice already and weren't passed over before, so round
+//robin order is never off by more than one slice. When pinned workers are on more than
+//one NUMA node, each process's lines get pages of their own on the node of its home worker
+//(process i goes to worker i mod N), asked for with mbind, and that worker prefers it from the
+//start. A process taken over by another worker counts in mysh_worker_migrations_total and, if
+//that one is on another node, mysh_worker_node_migrations_total.
+//Variables go through a variable store (see varstore.h) so every worker sees every set: the
+//--vars file if there is one, otherwise a memfd store the shell attaches on the first run and
+//keeps. Values of STORE_VALUE_LENGTH characters or more stay in the worker that set them, so
+//does my_cd. A worker that starts background jobs (exec ... &) runs them before it exits.
+//AGING, STRIDE, LOTTERY and EDF look at the whole queue every instruction, so execs with them,
+//execs with #, execs in a script and execs while background jobs are unfinished run in the
+//shell like before. Runs on workers aren't checkpointed or recorded by record.
+
+#   define WORKERS_MAX 64       //most workers an exec can use
+#   define WORKER_CRASHES_MAX 2 //workers a process may kill in one line before it is dropped
+#   define WORKER_AFFINITY_SCAN 4       //queued processes a worker looks through for one it ran last
+
+extern int worker_count;        //workers execs use, 0 for none
+extern int worker_pinning;      //workers are pinned to CPUs
+
+//run the programs of a foreground exec on the workers and close them, returns 0, or -1 with
+//the programs still open if the exec should run in the shell: policy isn't one workers run, or
+//no worker could be started
+int workers_run(BackingStore * programs[], int program_count, int policy);
+
+#endif